@@ -9,8 +9,18 @@
  */
 
 #include "Buffer.h"
+#include "Util/logger.h"
 #include "Util/onceToken.h"
 
+#if defined(__linux__) || defined(__linux)
+#include <netinet/udp.h>
+#include <sys/sendfile.h>
+#endif
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 namespace toolkit {
 
 StatisticImp(Buffer);
@@ -18,18 +28,111 @@ StatisticImp(BufferRaw);
 StatisticImp(BufferLikeString);
 StatisticImp(BufferList);
 
-BufferRaw::Ptr BufferRaw::create(){
-#if 0
-    static ResourcePool<BufferRaw> packet_pool;
-    static onceToken token([]() {
-        packet_pool.setSize(1024);
+BufferRaw::Ptr BufferRaw::create(size_t capacity){
+    //数据内存由BufferSlab循环使用，对象本身无需再通过ResourcePool复用
+    return Ptr(new BufferRaw(capacity));
+}
+
+///////////////BufferChain/////////////////////
+
+template<typename FUNC>
+void BufferChain::forRange(const Buffer::Ptr &buf, size_t offset, size_t len, FUNC &&func) {
+    auto total = buf->size();
+    assert(offset <= total);
+    if (!len) {
+        len = total - offset;
+    }
+    assert(offset + len <= total);
+    auto chain = buf->chain();
+    if (chain) {
+        //展开嵌套的分段缓存
+        forSlices(chain->_slices, offset, len, func);
+        return;
+    }
+    //文件缓存没有内存数据，不能作为片段
+    assert(buf->data());
+    if (len) {
+        func(Slice{buf, offset, len});
+    }
+}
+
+template<typename FUNC>
+void BufferChain::forSlices(const deque<Slice> &slices, size_t offset, size_t len, FUNC &&func) {
+    for (auto &slice : slices) {
+        if (!len) {
+            break;
+        }
+        if (offset >= slice.len) {
+            offset -= slice.len;
+            continue;
+        }
+        auto n = std::min(slice.len - offset, len);
+        func(Slice{slice.buf, slice.offset + offset, n});
+        offset = 0;
+        len -= n;
+    }
+}
+
+void BufferChain::append(Buffer::Ptr buf, size_t offset, size_t len) {
+    //buf可能就是本对象，遍历其片段时不能修改_slices，所以先收集再追加
+    vector<Slice> slices;
+    forRange(buf, offset, len, [&](Slice &&slice) {
+        _size += slice.len;
+        slices.emplace_back(std::move(slice));
+    });
+    _slices.insert(_slices.end(), make_move_iterator(slices.begin()), make_move_iterator(slices.end()));
+    _flat = nullptr;
+}
+
+void BufferChain::prepend(Buffer::Ptr buf, size_t offset, size_t len) {
+    vector<Slice> slices;
+    forRange(buf, offset, len, [&](Slice &&slice) {
+        _size += slice.len;
+        slices.emplace_back(std::move(slice));
+    });
+    _slices.insert(_slices.begin(), make_move_iterator(slices.begin()), make_move_iterator(slices.end()));
+    _flat = nullptr;
+}
+
+BufferChain::Ptr BufferChain::slice(size_t offset, size_t len) const {
+    assert(offset <= _size);
+    if (!len) {
+        len = _size - offset;
+    }
+    assert(offset + len <= _size);
+    auto ret = std::make_shared<BufferChain>();
+    forSlices(_slices, offset, len, [&](Slice &&slice) {
+        ret->_size += slice.len;
+        ret->_slices.emplace_back(std::move(slice));
     });
-    auto ret = packet_pool.obtain();
-    ret->setSize(0);
     return ret;
-#else
-    return Ptr(new BufferRaw);
-#endif
+}
+
+char *BufferChain::data() const {
+    if (_slices.size() == 1) {
+        //只有一个片段时本身就是连续内存
+        auto &slice = _slices.front();
+        return slice.buf->data() + slice.offset;
+    }
+    //同一对象可能被多个线程同时读取(比如udp发送至多个poller)，合并后的连续内存通过原子操作设置
+    auto flat = std::atomic_load(&_flat);
+    if (!flat) {
+        auto raw = BufferRaw::create();
+        raw->setCapacity(_size + 1);
+        auto ptr = raw->data();
+        for_each([&](const char *data, size_t len) {
+            memcpy(ptr, data, len);
+            ptr += len;
+        });
+        raw->setSize(_size);
+        flat = std::move(raw);
+        std::shared_ptr<Buffer> expected;
+        if (!std::atomic_compare_exchange_strong(&_flat, &expected, flat)) {
+            //其他线程已经合并完成，使用其结果，保证各线程返回同一地址
+            flat = std::move(expected);
+        }
+    }
+    return flat->data();
 }
 
 ///////////////BufferList/////////////////////
@@ -67,44 +170,221 @@ int sendmsg(int fd, const struct msghdr *msg, int flags) {
 }
 #endif // defined(_WIN32)
 
-ssize_t BufferList::send_l(int fd, int flags,bool udp) {
-    ssize_t n;
+//udp发送统计
+static atomic<uint64_t> s_udp_send_packets{0};
+static atomic<uint64_t> s_udp_send_syscalls{0};
+
+uint64_t BufferList::getUdpSendPackets() {
+    return s_udp_send_packets.load(memory_order_relaxed);
+}
+
+uint64_t BufferList::getUdpSendSyscalls() {
+    return s_udp_send_syscalls.load(memory_order_relaxed);
+}
+
+#if defined(__linux__) || defined(__linux)
+
+//单次sendmmsg最多发送的消息个数
+static constexpr size_t kSendMsgMax = 64;
+//UDP_SEGMENT单次最多分片个数，与内核UDP_MAX_SEGMENTS一致
+static constexpr size_t kGsoMaxSegments = 64;
+//UDP_SEGMENT单次最多发送字节数
+static constexpr size_t kGsoMaxBytes = 65507;
+
+ssize_t BufferList::send_mmsg(int fd, int flags, bool udp_gso) {
+    if (_pkt_array.empty()) {
+        //第一次批量发送，建立iovec与数据包的对应关系
+        _pkt_array.resize(_iovec.size());
+        auto i = _iovec_off;
+        _pkt_list.for_each([&](BufferSock::Ptr &buffer) {
+            _pkt_array[i++] = buffer.get();
+        });
+        _mmsgs.resize(std::min(_iovec.size(), kSendMsgMax));
+    }
+#if defined(UDP_SEGMENT)
+    udp_gso = udp_gso && !_udp_gso_unsupported;
+    const size_t cmsg_space = CMSG_SPACE(sizeof(uint16_t));
+    if (udp_gso && _control.empty()) {
+        _control.resize(_mmsgs.size() * cmsg_space);
+    }
+#else
+    udp_gso = false;
+#endif
+
+    auto is_same_addr = [](const BufferSock *a, const BufferSock *b) {
+        return a->_addr_len == b->_addr_len && (!a->_addr_len || 0 == memcmp(a->_addr, b->_addr, a->_addr_len));
+    };
+
+    bool use_gso = false;
+    size_t count = 0;
+    for (auto i = _iovec_off; i < _iovec.size() && count < _mmsgs.size(); ++count) {
+        auto pkt = _pkt_array[i];
+        auto &hdr = _mmsgs[count].msg_hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.msg_name = pkt->_addr;
+        hdr.msg_namelen = pkt->_addr_len;
+        hdr.msg_iov = &_iovec[i];
+
+        size_t segments = 1;
+        size_t segment_size = _iovec[i].iov_len;
+        size_t total = segment_size;
+        while (udp_gso && segment_size && i + segments < _iovec.size() && segments < kGsoMaxSegments) {
+            //合并目标地址相同的连续数据包，只有最后一个分片可以比前面的小
+            auto len = _iovec[i + segments].iov_len;
+            if (!len || len > segment_size || total + len > kGsoMaxBytes || !is_same_addr(pkt, _pkt_array[i + segments])) {
+                break;
+            }
+            total += len;
+            ++segments;
+            if (len < segment_size) {
+                break;
+            }
+        }
+        hdr.msg_iovlen = segments;
+
+#if defined(UDP_SEGMENT)
+        if (segments > 1) {
+            hdr.msg_control = &_control[count * cmsg_space];
+            hdr.msg_controllen = cmsg_space;
+            auto cm = CMSG_FIRSTHDR(&hdr);
+            cm->cmsg_level = SOL_UDP;
+            cm->cmsg_type = UDP_SEGMENT;
+            cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            *((uint16_t *) CMSG_DATA(cm)) = (uint16_t) segment_size;
+            use_gso = true;
+        }
+#endif
+        i += segments;
+    }
+
+    int sent;
     do {
-        struct msghdr msg;
-        if (!udp) {
-            msg.msg_name = NULL;
-            msg.msg_namelen = 0;
-        } else {
-            auto &buffer = _pkt_list.front();
-            msg.msg_name = buffer->_addr;
-            msg.msg_namelen = buffer->_addr_len;
+        sent = sendmmsg(fd, &_mmsgs[0], (unsigned) count, flags);
+    } while (-1 == sent && UV_EINTR == get_uv_error(true));
+    s_udp_send_syscalls.fetch_add(1, memory_order_relaxed);
+
+    if (-1 == sent) {
+        if (use_gso) {
+            auto err = get_uv_error(false);
+            if (err == UV_EIO || err == UV_EINVAL || err == UV_ENOTSUP) {
+                //内核或该socket的路由、网卡不支持UDP_SEGMENT，不合并重新发送；只影响本socket
+                _udp_gso_unsupported = true;
+                return send_mmsg(fd, flags, false);
+            }
         }
+        return -1;
+    }
 
-        msg.msg_iov = &(_iovec[_iovec_off]);
-        msg.msg_iovlen = (decltype(msg.msg_iovlen)) (_iovec.size() - _iovec_off);
-        size_t max = udp ? 1 : IOV_MAX;
-        if (msg.msg_iovlen > max) {
-            msg.msg_iovlen = max;
+    ssize_t n = 0;
+    size_t packets = 0;
+    for (int i = 0; i < sent; ++i) {
+        auto &hdr = _mmsgs[i].msg_hdr;
+        for (size_t j = 0; j < hdr.msg_iovlen; ++j) {
+            n += hdr.msg_iov[j].iov_len;
         }
-        msg.msg_control = NULL;
-        msg.msg_controllen = 0;
-        msg.msg_flags = flags;
-        n = sendmsg(fd, &msg, flags);
-    } while (-1 == n && UV_EINTR == get_uv_error(true));
+        packets += hdr.msg_iovlen;
+    }
+    s_udp_send_packets.fetch_add(packets, memory_order_relaxed);
+    return n;
+}
+
+#endif //defined(__linux__) || defined(__linux)
+
+ssize_t BufferList::send_l(int fd, int flags, bool udp, bool udp_gso, bool zerocopy) {
+    ssize_t n;
+    //本次发送完成的数据包需要转移至该列队，待内核通知后再回收
+    List<BufferSock::Ptr> *zerocopy_list = nullptr;
+#if defined(__linux__) || defined(__linux)
+    if (udp) {
+        //udp数据包批量发送
+        n = send_mmsg(fd, flags, udp_gso);
+    } else
+#endif
+    {
+#if defined(MSG_ZEROCOPY)
+        if (zerocopy) {
+            flags |= MSG_ZEROCOPY;
+        }
+#endif
+#if !defined(_WIN32)
+        if (_has_file && !_iovec[_iovec_off].iov_base) {
+            //文件数据，由内核直接写入socket
+            auto &ref = _iovec[_iovec_off];
+            auto file = static_cast<BufferFile *>(_pkt_list.front()->_buffer.get());
+            n = file->sendTo(fd, file->size() - ref.iov_len, ref.iov_len, flags);
+            zerocopy = false;
+        } else
+#endif
+        do {
+            struct msghdr msg;
+            if (!udp) {
+                msg.msg_name = NULL;
+                msg.msg_namelen = 0;
+            } else {
+                auto &buffer = _pkt_list.front();
+                msg.msg_name = buffer->_addr;
+                msg.msg_namelen = buffer->_addr_len;
+            }
+
+            msg.msg_iov = &(_iovec[_iovec_off]);
+            msg.msg_iovlen = (decltype(msg.msg_iovlen)) (_iovec.size() - _iovec_off);
+            size_t max = udp ? 1 : IOV_MAX;
+            if (msg.msg_iovlen > max) {
+                msg.msg_iovlen = max;
+            }
+            if (_has_file) {
+                //遇到文件数据为止
+                for (size_t i = 1; i < msg.msg_iovlen; ++i) {
+                    if (!msg.msg_iov[i].iov_base) {
+                        msg.msg_iovlen = (decltype(msg.msg_iovlen)) i;
+                        break;
+                    }
+                }
+            }
+            msg.msg_control = NULL;
+            msg.msg_controllen = 0;
+            msg.msg_flags = flags;
+            n = sendmsg(fd, &msg, flags);
+        } while (-1 == n && UV_EINTR == get_uv_error(true));
+
+#if defined(MSG_ZEROCOPY)
+        if (-1 == n && zerocopy && ENOBUFS == errno) {
+            //超过optmem限制，本次退化为普通方式发送；get_uv_error会把ENOBUFS转换为EAGAIN，所以直接判断errno
+            return send_l(fd, flags & ~MSG_ZEROCOPY, udp, udp_gso, false);
+        }
+#endif
+
+        if (udp) {
+            s_udp_send_syscalls.fetch_add(1, memory_order_relaxed);
+            if (n != -1) {
+                s_udp_send_packets.fetch_add(1, memory_order_relaxed);
+            }
+        }
+        if (n > 0 && zerocopy) {
+            zerocopy_list = &_zerocopy->onSend();
+        } else if (n > 0 && _zerocopy) {
+            //数据包可能有部分数据已经以零拷贝方式发出，待之前的零拷贝发送全部完成后再回收
+            zerocopy_list = _zerocopy->pending();
+        }
+    }
 
     if (n >= (ssize_t) _remainSize) {
         //全部写完了
         _iovec_off = _iovec.size();
         _remainSize = 0;
-        _pkt_list.for_each([](BufferSock::Ptr &buffer){
-            buffer->onSendSuccess();
-        });
+        if (zerocopy_list) {
+            zerocopy_list->append(_pkt_list);
+        } else {
+            _pkt_list.for_each([](BufferSock::Ptr &buffer) {
+                buffer->onSendSuccess();
+            });
+        }
         return n;
     }
 
     if (n > 0) {
         //部分发送成功
-        reOffset(n);
+        reOffset(n, zerocopy_list);
         return n;
     }
 
@@ -112,9 +392,14 @@ ssize_t BufferList::send_l(int fd, int flags,bool udp) {
     return n;
 }
 
-ssize_t BufferList::send(int fd, int flags, bool udp) {
+ssize_t BufferList::send(int fd, int flags, bool udp, bool udp_gso, const ZeroCopyQueue::Ptr &zerocopy) {
+    //发送完毕的数据包只交由同一个列队回收，重连后的新fd上不再以零拷贝方式发送剩余数据
+    bool use_zerocopy = zerocopy && (!_zerocopy || _zerocopy == zerocopy);
+    if (use_zerocopy) {
+        _zerocopy = zerocopy;
+    }
     auto remainSize = _remainSize;
-    while (_remainSize && send_l(fd, flags, udp) != -1);
+    while (_remainSize && send_l(fd, flags, udp, udp_gso, use_zerocopy) != -1);
 
     ssize_t sent = remainSize - _remainSize;
     if (sent > 0) {
@@ -125,7 +410,23 @@ ssize_t BufferList::send(int fd, int flags, bool udp) {
     return -1;
 }
 
-void BufferList::reOffset(size_t n) {
+size_t BufferList::remainSize() const {
+    return _remainSize;
+}
+
+bool BufferList::isZeroCopyUsed() const {
+    return _zerocopy != nullptr;
+}
+
+bool BufferList::isUdpGsoUnsupported() const {
+#if defined(__linux__) || defined(__linux)
+    return _udp_gso_unsupported;
+#else
+    return false;
+#endif
+}
+
+void BufferList::reOffset(size_t n, List<BufferSock::Ptr> *zerocopy_list) {
     _remainSize -= n;
     size_t offset = 0;
     auto last_off = _iovec_off;
@@ -136,7 +437,10 @@ void BufferList::reOffset(size_t n) {
             continue;
         }
         ssize_t remain = offset - n;
-        ref.iov_base = (char *) ref.iov_base + ref.iov_len - remain;
+        if (ref.iov_base) {
+            //文件数据的iov_base固定为空，发送偏移量由剩余长度计算
+            ref.iov_base = (char *) ref.iov_base + ref.iov_len - remain;
+        }
         ref.iov_len = (decltype(ref.iov_len)) remain;
         _iovec_off = i;
         if (remain == 0) {
@@ -147,23 +451,116 @@ void BufferList::reOffset(size_t n) {
 
     //删除已经发送的数据，节省内存
     for (auto i = last_off; i < _iovec_off; ++i) {
+        if (_has_chain && !_iovec_end[i]) {
+            //分段缓存的中间片段，数据包尚未发送完毕
+            continue;
+        }
         auto &front = _pkt_list.front();
-        front->onSendSuccess();
+        if (zerocopy_list) {
+            //零拷贝发送，内核通知发送完成后再回收
+            zerocopy_list->emplace_back(std::move(front));
+        } else {
+            front->onSendSuccess();
+        }
         _pkt_list.pop_front();
     }
 }
 
-BufferList::BufferList(List<BufferSock::Ptr> &list) : _iovec(list.size()) {
+///////////////ZeroCopyQueue/////////////////////
+
+List<BufferSock::Ptr> &ZeroCopyQueue::onSend() {
+    _entries.emplace_back();
+    return _entries.back().pkt_list;
+}
+
+void ZeroCopyQueue::onComplete(uint32_t lo, uint32_t hi, bool copied) {
+    if (copied) {
+        _copied = true;
+    }
+    for (auto id = lo;; ++id) {
+        //序号为32位循环计数，相减即为下标
+        size_t index = (uint32_t) (id - _front_id);
+        if (index < _entries.size()) {
+            _entries[index].done = true;
+        }
+        if (id == hi) {
+            break;
+        }
+    }
+    //按发送顺序回收数据包
+    while (!_entries.empty() && _entries.front().done) {
+        _entries.front().pkt_list.for_each([](BufferSock::Ptr &buffer) {
+            buffer->onSendSuccess();
+        });
+        _entries.pop_front();
+        ++_front_id;
+    }
+}
+
+List<BufferSock::Ptr> *ZeroCopyQueue::pending() {
+    //列队中的发送按序号顺序回收，放入最后一次发送即可保证在之前所有发送完成后回收
+    return _entries.empty() ? nullptr : &_entries.back().pkt_list;
+}
+
+bool ZeroCopyQueue::isCopied() const {
+    return _copied;
+}
+
+size_t ZeroCopyQueue::size() const {
+    return _entries.size();
+}
+
+BufferList::BufferList(List<BufferSock::Ptr> &list, bool udp) {
     _pkt_list.swap(list);
-    auto it = _iovec.begin();
+    _iovec.reserve(_pkt_list.size());
     _pkt_list.for_each([&](BufferSock::Ptr &buffer) {
-        it->iov_base = buffer->data();
-        it->iov_len = (decltype(it->iov_len)) buffer->size();
-        _remainSize += it->iov_len;
-        ++it;
+        auto chain = udp ? nullptr : buffer->chain();
+        if (chain && chain->count() > 1) {
+            //分段缓存直接展开为多个iovec
+            if (!_has_chain) {
+                _has_chain = true;
+                _iovec_end.assign(_iovec.size(), true);
+            }
+            chain->for_each([&](char *data, size_t len) {
+                struct iovec iov;
+                iov.iov_base = data;
+                iov.iov_len = (decltype(iov.iov_len)) len;
+                _iovec.emplace_back(iov);
+                _iovec_end.emplace_back(false);
+            });
+            _iovec_end.back() = true;
+            _remainSize += chain->size();
+            return;
+        }
+        struct iovec iov;
+        iov.iov_base = buffer->data();
+        iov.iov_len = (decltype(iov.iov_len)) buffer->size();
+        if (!iov.iov_base) {
+            //BufferFile
+            _has_file = true;
+        }
+        _remainSize += iov.iov_len;
+        _iovec.emplace_back(iov);
+        if (_has_chain) {
+            _iovec_end.emplace_back(true);
+        }
     });
 }
 
+BufferList::~BufferList() {
+    if (_zerocopy && !_pkt_list.empty()) {
+        if (auto list = _zerocopy->pending()) {
+            //未发送完毕的数据包可能有部分数据已经以零拷贝方式发出：通知发送失败，内存待内核通知后再回收
+            auto &front = _pkt_list.front();
+            if (front->_result) {
+                front->_result(0);
+                front->_result = nullptr;
+            }
+            list->emplace_back(std::move(front));
+        }
+    }
+}
+
 BufferSock::BufferSock(Buffer::Ptr buffer, struct sockaddr *addr, int addr_len, onResult cb) {
     if (addr && addr_len) {
         _addr = (struct sockaddr *) malloc(addr_len);
@@ -193,6 +590,10 @@ size_t BufferSock::size() const {
     return _buffer->size();
 }
 
+const BufferChain *BufferSock::chain() const {
+    return _buffer->chain();
+}
+
 void BufferSock::onSendSuccess() {
     if (_result) {
         _result(size());
@@ -204,4 +605,419 @@ void BufferSock::setSendResult(onResult cb){
     _result = std::move(cb);
 }
 
+///////////////BufferFile/////////////////////
+
+#if !defined(_WIN32)
+
+BufferFile::Ptr BufferFile::create(int fd, uint64_t offset, size_t size) {
+    auto new_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (new_fd == -1) {
+        WarnL << "复制文件描述符失败:" << get_uv_errmsg(false);
+        return nullptr;
+    }
+    return Ptr(new BufferFile(new_fd, offset, size));
+}
+
+BufferFile::BufferFile(int fd, uint64_t offset, size_t size) {
+    _fd = fd;
+    _offset = offset;
+    _size = size;
+}
+
+BufferFile::~BufferFile() {
+    close(_fd);
+}
+
+string BufferFile::toString() const {
+    string ret;
+    ret.resize(_size);
+    size_t total = 0;
+    while (total < _size) {
+        auto n = pread(_fd, &ret[total], _size - total, _offset + total);
+        if (n <= 0) {
+            break;
+        }
+        total += n;
+    }
+    ret.resize(total);
+    return ret;
+}
+
+ssize_t BufferFile::sendTo(int sock, size_t offset, size_t size, int flags) const {
+    ssize_t n;
+#if defined(__linux__) || defined(__linux)
+    //sendfile不支持flags
+    (void) flags;
+    off_t off = _offset + offset;
+    do {
+        n = sendfile(sock, _fd, &off, size);
+    } while (-1 == n && UV_EINTR == get_uv_error(true));
+    if (n == 0 && size) {
+        //文件长度不足
+        errno = EIO;
+        return -1;
+    }
+#else
+    //不支持sendfile的平台，分块读取后写入socket
+    char buf[32 * 1024];
+    do {
+        n = pread(_fd, buf, std::min(size, sizeof(buf)), _offset + offset);
+    } while (-1 == n && UV_EINTR == get_uv_error(false));
+    if (n <= 0) {
+        if (n == 0) {
+            //文件长度不足
+            errno = EIO;
+        }
+        return -1;
+    }
+    auto len = n;
+    do {
+        n = ::send(sock, buf, len, flags);
+    } while (-1 == n && UV_EINTR == get_uv_error(true));
+#endif
+    return n;
+}
+
+#endif //!defined(_WIN32)
+
+///////////////SocketRecvBuffer/////////////////////
+
+//单个数据包接收缓存，使用recvfrom读取
+class SocketRecvFromBuffer : public SocketRecvBuffer {
+public:
+    SocketRecvFromBuffer() {
+        auto buf = BufferRaw::create();
+        //预留一个字节存放\0结尾符
+        buf->setCapacity(1 + SOCKET_DEFAULT_BUF_SIZE);
+        _buffer = std::move(buf);
+    }
+
+    ssize_t recvFromSocket(int fd, ssize_t &count) override {
+        ssize_t nread;
+        auto &buf = static_cast<BufferRaw &>(*_buffer);
+        auto data = buf.data();
+        auto capacity = buf.getCapacity() - 1;
+        do {
+            _addr_len = sizeof(_addr);
+            nread = recvfrom(fd, data, capacity, 0, (struct sockaddr *) &_addr, &_addr_len);
+        } while (-1 == nread && UV_EINTR == get_uv_error(true));
+
+        if (nread > 0) {
+            count = 1;
+            data[nread] = '\0';
+            //设置buffer有效数据大小
+            buf.setSize(nread);
+        }
+        return nread;
+    }
+
+    Buffer::Ptr &getBuffer(size_t /*index*/) override {
+        return _buffer;
+    }
+
+    struct sockaddr *getAddress(size_t /*index*/, int &addr_len) override {
+        addr_len = (int) _addr_len;
+        return (struct sockaddr *) &_addr;
+    }
+
+private:
+    Buffer::Ptr _buffer;
+    socklen_t _addr_len;
+    struct sockaddr_storage _addr;
+};
+
+//循环池接收缓存的各级大小，与BufferSlab的分级对应，tcp根据每次读取的数据量在各级之间自适应调整
+static constexpr size_t kRecvPoolSizes[] = {2 * 1024, 16 * 1024, 64 * 1024, 256 * 1024};
+static constexpr size_t kRecvPoolLevels = sizeof(kRecvPoolSizes) / sizeof(kRecvPoolSizes[0]);
+//udp数据包先接收至该级缓存(可容纳一个rtp数据包)，超出部分接收至溢出缓存
+static constexpr size_t kRecvPoolUdpLevel = 0;
+//连续多少次读取的数据量小于本级大小的1/4时降级
+static constexpr size_t kRecvPoolShrinkCount = 8;
+//循环池模式下批量接收的最大数据包个数，每个socket独享这些缓存，所以比共享模式少
+static constexpr size_t kRecvPoolPacketCount = 4;
+//单个数据包接收缓存大小，可容纳最大udp数据包
+static constexpr size_t kRecvPacketCapacity = 64 * 1024;
+
+static BufferRaw::Ptr obtainRecvBuffer(size_t level) {
+    //BufferSlab的线程缓存与全局仓库均按numa节点区分，所以内存位于本节点
+    return BufferRaw::create(kRecvPoolSizes[level]);
+}
+
+#if !defined(_WIN32)
+
+/**
+ * 获取本线程的udp溢出缓存，每个数据包占用其中的kRecvPacketCapacity字节
+ * 接收只在poller线程中进行，且溢出数据在recvFromSocket返回前已经取走，所以同一线程下的socket可以共享
+ */
+static char *getRecvOverflow(size_t index) {
+    static thread_local std::unique_ptr<char[]> s_overflow;
+    if (!s_overflow) {
+        s_overflow.reset(new char[kRecvPoolPacketCount * kRecvPacketCapacity]);
+    }
+    return s_overflow.get() + index * kRecvPacketCapacity;
+}
+
+//设置udp数据包的接收iovec，先填满buf(预留一个字节存放\0结尾符)，超出部分写入溢出缓存
+static void setRecvIovec(struct iovec *iov, BufferRaw &buf, size_t index) {
+    iov[0].iov_base = buf.data();
+    iov[0].iov_len = buf.getCapacity() - 1;
+    iov[1].iov_base = getRecvOverflow(index);
+    iov[1].iov_len = kRecvPacketCapacity;
+}
+
+/**
+ * 获取交给使用者的udp数据包
+ * 数据包未溢出时直接返回接收它的缓存；溢出时合并至按实际长度分配的大缓存，接收缓存留在本socket继续使用
+ */
+static Buffer::Ptr takeRecvPacket(const Buffer::Ptr &buf, const struct iovec *iov, size_t len) {
+    auto head = iov[0].iov_len;
+    if (len <= head) {
+        auto &raw = static_cast<BufferRaw &>(*buf);
+        raw.data()[len] = '\0';
+        //设置buffer有效数据大小
+        raw.setSize(len);
+        return buf;
+    }
+    //预留一个字节存放\0结尾符
+    auto ret = BufferRaw::create(len + 1);
+    memcpy(ret->data(), iov[0].iov_base, head);
+    memcpy(ret->data() + head, iov[1].iov_base, len - head);
+    ret->data()[len] = '\0';
+    ret->setSize(len);
+    return ret;
+}
+
+#endif //!defined(_WIN32)
+
+#if defined(__linux__) || defined(__linux)
+
+//批量接收的最大数据包个数
+static constexpr size_t kRecvPacketCount = 16;
+
+//udp数据包批量接收缓存，使用recvmmsg读取
+class SocketRecvmmsgBuffer : public SocketRecvBuffer {
+public:
+    /**
+     * @param use_pool 是否从循环池获取缓存，开启后每个数据包接收至独立的小缓存，被使用者持有的缓存会在下次接收前替换
+     */
+    SocketRecvmmsgBuffer(bool use_pool = false) {
+        _use_pool = use_pool;
+        auto count = use_pool ? kRecvPoolPacketCount : kRecvPacketCount;
+        _buffers.resize(count);
+        if (use_pool) {
+            _packets.resize(count);
+        }
+        _mmsgs.resize(count);
+        //循环池模式下每个数据包使用两个iovec: 独享的小缓存与线程共享的溢出缓存
+        _iovec.resize(use_pool ? 2 * count : count);
+        _address.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            auto &hdr = _mmsgs[i].msg_hdr;
+            memset(&hdr, 0, sizeof(hdr));
+            hdr.msg_iov = use_pool ? &_iovec[2 * i] : &_iovec[i];
+            hdr.msg_iovlen = use_pool ? 2 : 1;
+            hdr.msg_name = &_address[i];
+            if (use_pool) {
+                _buffers[i] = obtainRecvBuffer(kRecvPoolUdpLevel);
+            } else {
+                auto buf = BufferRaw::create(kRecvPacketCapacity);
+                //预留一个字节存放\0结尾符
+                _iovec[i].iov_base = buf->data();
+                _iovec[i].iov_len = buf->getCapacity() - 1;
+                _buffers[i] = std::move(buf);
+            }
+        }
+    }
+
+    ssize_t recvFromSocket(int fd, ssize_t &count) override {
+        if (_use_pool) {
+            for (size_t i = 0; i < _packets.size(); ++i) {
+                _packets[i] = nullptr;
+                if (_buffers[i].use_count() > 1) {
+                    //上次的数据被使用者持有，重新获取
+                    _buffers[i] = obtainRecvBuffer(kRecvPoolUdpLevel);
+                }
+                //溢出缓存属于当前线程，每次接收前重新设置
+                setRecvIovec(_mmsgs[i].msg_hdr.msg_iov, static_cast<BufferRaw &>(*_buffers[i]), i);
+            }
+        }
+        for (auto &mmsg : _mmsgs) {
+            //地址长度与数据长度会被内核修改，每次接收前需要重置
+            mmsg.msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+            mmsg.msg_len = 0;
+        }
+        int n;
+        do {
+            n = recvmmsg(fd, &_mmsgs[0], (unsigned) _mmsgs.size(), 0, nullptr);
+        } while (-1 == n && UV_EINTR == get_uv_error(true));
+
+        if (n <= 0) {
+            return n;
+        }
+
+        ssize_t nread = 0;
+        for (int i = 0; i < n; ++i) {
+            auto len = _mmsgs[i].msg_len;
+            nread += len;
+            if (_use_pool) {
+                _packets[i] = takeRecvPacket(_buffers[i], _mmsgs[i].msg_hdr.msg_iov, len);
+                continue;
+            }
+            auto &buf = static_cast<BufferRaw &>(*_buffers[i]);
+            buf.data()[len] = '\0';
+            //设置buffer有效数据大小
+            buf.setSize(len);
+        }
+        count = n;
+        return nread;
+    }
+
+    Buffer::Ptr &getBuffer(size_t index) override {
+        return _use_pool ? _packets[index] : _buffers[index];
+    }
+
+    struct sockaddr *getAddress(size_t index, int &addr_len) override {
+        addr_len = (int) _mmsgs[index].msg_hdr.msg_namelen;
+        return (struct sockaddr *) &_address[index];
+    }
+
+private:
+    bool _use_pool;
+    vector<Buffer::Ptr> _buffers;
+    //循环池模式下交给使用者的数据包，与_buffers一一对应
+    vector<Buffer::Ptr> _packets;
+    vector<struct mmsghdr> _mmsgs;
+    vector<struct iovec> _iovec;
+    vector<struct sockaddr_storage> _address;
+};
+
+#endif //defined(__linux__) || defined(__linux)
+
+//从循环池获取的接收缓存，每个socket独享
+class SocketRecvPoolBuffer : public SocketRecvBuffer {
+public:
+    SocketRecvPoolBuffer(bool is_udp) {
+        _is_udp = is_udp;
+#if defined(_WIN32)
+        //不支持分散读取，udp直接使用可容纳最大udp数据包的缓存
+        _level = is_udp ? 2 : 1;
+#else
+        _level = is_udp ? kRecvPoolUdpLevel : 1;
+#endif
+    }
+
+    ssize_t recvFromSocket(int fd, ssize_t &count) override {
+        _packet = nullptr;
+        if (!_buffer || _buffer.use_count() > 1 || _buffer->getCapacity() != kRecvPoolSizes[_level]) {
+            //上次的数据被使用者持有或缓存大小调整了，重新获取
+            _buffer = obtainRecvBuffer(_level);
+        }
+        auto &buf = static_cast<BufferRaw &>(*_buffer);
+#if !defined(_WIN32)
+        if (_is_udp) {
+            return recvUdp(fd, count, buf);
+        }
+#endif
+        auto data = buf.data();
+        auto capacity = buf.getCapacity() - 1;
+        ssize_t nread;
+        do {
+            _addr_len = sizeof(_addr);
+            nread = recvfrom(fd, data, capacity, 0, (struct sockaddr *) &_addr, &_addr_len);
+        } while (-1 == nread && UV_EINTR == get_uv_error(true));
+
+        if (nread > 0) {
+            count = 1;
+            data[nread] = '\0';
+            //设置buffer有效数据大小
+            buf.setSize(nread);
+            if (!_is_udp) {
+                adjustLevel(nread, capacity);
+            }
+        }
+        return nread;
+    }
+
+    Buffer::Ptr &getBuffer(size_t /*index*/) override {
+        return _packet ? _packet : _buffer;
+    }
+
+    struct sockaddr *getAddress(size_t /*index*/, int &addr_len) override {
+        addr_len = (int) _addr_len;
+        return (struct sockaddr *) &_addr;
+    }
+
+private:
+#if !defined(_WIN32)
+    ssize_t recvUdp(int fd, ssize_t &count, BufferRaw &buf) {
+        struct iovec iov[2];
+        setRecvIovec(iov, buf, 0);
+        struct msghdr hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.msg_name = &_addr;
+        hdr.msg_iov = iov;
+        hdr.msg_iovlen = 2;
+        ssize_t nread;
+        do {
+            hdr.msg_namelen = sizeof(_addr);
+            nread = recvmsg(fd, &hdr, 0);
+        } while (-1 == nread && UV_EINTR == get_uv_error(true));
+
+        if (nread > 0) {
+            count = 1;
+            _addr_len = hdr.msg_namelen;
+            _packet = takeRecvPacket(_buffer, iov, nread);
+        }
+        return nread;
+    }
+#endif
+
+    void adjustLevel(size_t nread, size_t capacity) {
+        if (nread == capacity) {
+            //缓存被读满，下次使用更大的缓存
+            _small_count = 0;
+            if (_level + 1 < kRecvPoolLevels) {
+                ++_level;
+            }
+            return;
+        }
+        if (_level && nread < capacity / 4) {
+            if (++_small_count >= kRecvPoolShrinkCount) {
+                //数据量持续偏小，下次使用更小的缓存
+                _small_count = 0;
+                --_level;
+            }
+            return;
+        }
+        _small_count = 0;
+    }
+
+private:
+    bool _is_udp;
+    size_t _level;
+    size_t _small_count = 0;
+    Buffer::Ptr _buffer;
+    //udp时交给使用者的数据包
+    Buffer::Ptr _packet;
+    socklen_t _addr_len;
+    struct sockaddr_storage _addr;
+};
+
+SocketRecvBuffer::Ptr SocketRecvBuffer::create(bool is_udp, bool use_pool) {
+    if (use_pool) {
+#if defined(__linux__) || defined(__linux)
+        if (is_udp) {
+            return std::make_shared<SocketRecvmmsgBuffer>(true);
+        }
+#endif
+        return std::make_shared<SocketRecvPoolBuffer>(is_udp);
+    }
+#if defined(__linux__) || defined(__linux)
+    if (is_udp) {
+        return std::make_shared<SocketRecvmmsgBuffer>();
+    }
+#endif
+    return std::make_shared<SocketRecvFromBuffer>();
+}
+
 }//namespace toolkit
\ No newline at end of file
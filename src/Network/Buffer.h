@@ -26,6 +26,7 @@
 #include "Util/uv_errno.h"
 #include "Util/ResourcePool.h"
 #include "Network/sockutil.h"
+#include "Network/BufferSlab.h"
 using namespace std;
 
 namespace std {
@@ -34,6 +35,8 @@ namespace std {
 }
 
 namespace toolkit {
+class BufferChain;
+
 //缓存基类
 class Buffer : public noncopyable {
 public:
@@ -52,6 +55,11 @@ public:
         return size();
     }
 
+    //非连续内存的缓存(BufferChain)返回自身，此时data()需要拷贝合并数据，应优先按分段访问
+    virtual const BufferChain *chain() const {
+        return nullptr;
+    }
+
 private:
     //对象个数统计
     ObjectStatistic<Buffer> _statistic;
@@ -111,16 +119,20 @@ private:
 
 typedef BufferOffset<string> BufferString;
 
-//指针式缓存对象，
+//指针式缓存对象，数据内存由BufferSlab分级分配并循环使用
 class BufferRaw : public Buffer{
 public:
     using Ptr = std::shared_ptr<BufferRaw>;
 
-    static Ptr create();
+    /**
+     * 创建缓存
+     * @param capacity 预分配的内存大小，实际分配的大小向上取整至所属的分级，可通过getCapacity()获取
+     */
+    static Ptr create(size_t capacity = 0);
 
     ~BufferRaw() override{
         if(_data){
-            delete [] _data;
+            BufferSlab::free(_data, _capacity);
         }
     }
     //在写入数据时请确保内存是否越界
@@ -151,10 +163,9 @@ public:
                 }
             }while(false);
 
-            delete [] _data;
+            BufferSlab::free(_data, _capacity);
         }
-        _data = new char[capacity];
-        _capacity = capacity;
+        _data = BufferSlab::alloc(capacity, _capacity);
     }
     //设置有效数据大小
     void setSize(size_t size){
@@ -439,6 +450,144 @@ private:
     ObjectStatistic<BufferLikeString> _statistic;
 };
 
+/**
+ * 分段缓存，由多个Buffer对象的片段按顺序组成，用于不拷贝地拼接头部、负载与尾部等数据
+ * 追加、前插、切片均只引用原有缓存，不会分配新的数据内存
+ * tcp socket发送时BufferList直接把各片段展开为iovec，udp socket发送时会合并为连续内存
+ * 调用data()会把数据拷贝至一块连续内存(仅首次调用时拷贝)，应尽量避免
+ * 追加、前插等修改操作非线程安全；不再修改后可以在多个线程中同时读取，包括调用data()
+ */
+class BufferChain : public Buffer {
+public:
+    using Ptr = std::shared_ptr<BufferChain>;
+
+    BufferChain() = default;
+    ~BufferChain() override = default;
+
+    /**
+     * 在尾部追加缓存片段
+     * @param buf 缓存，为BufferChain时追加其片段
+     * @param offset 片段在buf中的偏移量
+     * @param len 片段长度，0代表到buf末尾
+     */
+    void append(Buffer::Ptr buf, size_t offset = 0, size_t len = 0);
+
+    /**
+     * 在头部插入缓存片段
+     * @param buf 缓存，为BufferChain时插入其片段
+     * @param offset 片段在buf中的偏移量
+     * @param len 片段长度，0代表到buf末尾
+     */
+    void prepend(Buffer::Ptr buf, size_t offset = 0, size_t len = 0);
+
+    /**
+     * 获取一段数据的视图，新对象与本对象共享数据内存
+     * @param offset 偏移量
+     * @param len 长度，0代表到末尾
+     */
+    Ptr slice(size_t offset, size_t len = 0) const;
+
+    /**
+     * 片段个数
+     */
+    size_t count() const {
+        return _slices.size();
+    }
+
+    /**
+     * 按顺序遍历各片段
+     * @param func 回调，签名为void(char *data, size_t len)
+     */
+    template<typename FUNC>
+    void for_each(FUNC &&func) const {
+        for (auto &slice : _slices) {
+            func(slice.buf->data() + slice.offset, slice.len);
+        }
+    }
+
+    char *data() const override;
+
+    size_t size() const override {
+        return _size;
+    }
+
+    const BufferChain *chain() const override {
+        return this;
+    }
+
+private:
+    struct Slice {
+        Buffer::Ptr buf;
+        size_t offset;
+        size_t len;
+    };
+
+    //遍历buf中[offset, offset + len)范围内的片段，len为0代表到末尾
+    template<typename FUNC>
+    static void forRange(const Buffer::Ptr &buf, size_t offset, size_t len, FUNC &&func);
+    template<typename FUNC>
+    static void forSlices(const deque<Slice> &slices, size_t offset, size_t len, FUNC &&func);
+
+private:
+    size_t _size = 0;
+    deque<Slice> _slices;
+    //data()时合并的连续内存，通过std::atomic_load/atomic_compare_exchange_strong访问
+    mutable std::shared_ptr<Buffer> _flat;
+};
+
+#if !defined(_WIN32)
+/**
+ * 文件缓存，指向文件中的一段数据，数据不会被读入内存
+ * tcp socket发送时直接由内核从文件拷贝至socket(linux下使用sendfile)
+ * data()固定返回nullptr，BufferList据此识别文件数据
+ */
+class BufferFile : public Buffer {
+public:
+    using Ptr = std::shared_ptr<BufferFile>;
+
+    /**
+     * 创建文件缓存
+     * @param fd 文件描述符，内部会复制一份，调用者可以立即关闭原fd
+     * @param offset 文件偏移量
+     * @param size 数据长度
+     * @return fd无效时返回nullptr
+     */
+    static Ptr create(int fd, uint64_t offset, size_t size);
+    ~BufferFile() override;
+
+    char *data() const override {
+        return nullptr;
+    }
+
+    size_t size() const override {
+        return _size;
+    }
+
+    /**
+     * 读取文件内容，仅用于调试，会把数据读入内存
+     */
+    string toString() const override;
+
+    /**
+     * 把文件数据写入socket
+     * @param sock socket fd
+     * @param offset 相对于本缓存起始位置的偏移量
+     * @param size 最多写入字节数
+     * @param flags 发送flags，不支持sendfile的平台有效
+     * @return 写入的字节数，-1代表失败
+     */
+    ssize_t sendTo(int sock, size_t offset, size_t size, int flags) const;
+
+private:
+    BufferFile(int fd, uint64_t offset, size_t size);
+
+private:
+    int _fd;
+    uint64_t _offset;
+    size_t _size;
+};
+#endif //!defined(_WIN32)
+
 #if defined(_WIN32)
 struct iovec {
     void *   iov_base;	/* [XSI] Base address of I/O memory region */
@@ -474,6 +623,7 @@ public:
 
     char *data() const override;
     size_t size() const override;
+    const BufferChain *chain() const override;
     void setSendResult(onResult cb);
     void onSendSuccess();
 
@@ -484,28 +634,184 @@ private:
     onResult _result;
 };
 
+/**
+ * MSG_ZEROCOPY方式发送的数据包列队
+ * 内核在数据真正发出前一直引用用户态内存，所以数据包需要保留至内核通过错误列队通知发送完成
+ * 内核对每次成功的MSG_ZEROCOPY发送按顺序分配一个32位序号，本对象与之一一对应
+ * 该对象非线程安全，只能在poller线程中操作
+ */
+class ZeroCopyQueue : public noncopyable {
+public:
+    using Ptr = std::shared_ptr<ZeroCopyQueue>;
+
+    ZeroCopyQueue() = default;
+    ~ZeroCopyQueue() = default;
+
+    /**
+     * 一次MSG_ZEROCOPY发送成功，分配下一个序号
+     * @return 该序号对应的数据包列队，本次发送完成的数据包需要放入其中
+     */
+    List<BufferSock::Ptr> &onSend();
+
+    /**
+     * 内核通知[lo, hi]序号范围内的发送已经完成
+     * @param copied 内核是否退化为拷贝方式发送
+     */
+    void onComplete(uint32_t lo, uint32_t hi, bool copied);
+
+    /**
+     * 内核是否退化为拷贝方式发送(例如回环网卡或网卡不支持)，此时零拷贝没有收益
+     */
+    bool isCopied() const;
+
+    /**
+     * 最后一次MSG_ZEROCOPY发送对应的数据包列队，放入其中的数据包待之前的发送全部完成后再回收
+     * @return 所有发送均已完成时返回nullptr，此时内核已不再引用用户态内存
+     */
+    List<BufferSock::Ptr> *pending();
+
+    /**
+     * 尚未完成的发送次数
+     */
+    size_t size() const;
+
+private:
+    struct Entry {
+        bool done = false;
+        List<BufferSock::Ptr> pkt_list;
+    };
+    bool _copied = false;
+    //_entries中第一个元素对应的序号
+    uint32_t _front_id = 0;
+    std::deque<Entry> _entries;
+};
+
 class BufferList : public noncopyable {
 public:
     typedef std::shared_ptr<BufferList> Ptr;
-    BufferList(List<BufferSock::Ptr> &list);
-    ~BufferList() {}
+    /**
+     * @param list 待发送的数据包，构造后被清空
+     * @param udp 是否为udp socket，udp数据包中的BufferChain会合并为连续内存，tcp则直接展开为多个iovec
+     */
+    BufferList(List<BufferSock::Ptr> &list, bool udp = false);
+    ~BufferList();
 
     bool empty();
     size_t count();
-    ssize_t send(int fd, int flags, bool udp);
+
+    /**
+     * 发送数据
+     * @param fd socket文件描述符
+     * @param flags 发送flags
+     * @param udp 是否为udp socket，linux下udp数据包使用sendmmsg批量发送
+     * @param udp_gso 是否把目标地址相同、大小相同的连续udp数据包合并成一次UDP_SEGMENT(GSO)发送
+     * @param zerocopy 不为空时tcp数据使用MSG_ZEROCOPY发送，发送完成的数据包转移至该列队，待内核通知后再回收
+     * @return 发送的字节数，-1代表一个字节都未发送成功
+     */
+    ssize_t send(int fd, int flags, bool udp, bool udp_gso = false, const ZeroCopyQueue::Ptr &zerocopy = nullptr);
+
+    /**
+     * 剩余未发送的字节数
+     */
+    size_t remainSize() const;
+
+    /**
+     * 是否已经使用MSG_ZEROCOPY方式发送
+     * 是则之后发送完毕的数据包都交由该零拷贝列队回收，所以剩余数据只能在poller线程中发送
+     */
+    bool isZeroCopyUsed() const;
+
+    /**
+     * 发送时是否发现该socket不支持UDP_SEGMENT，是则调用者应关闭该socket的udp gso
+     */
+    bool isUdpGsoUnsupported() const;
+
+    /**
+     * 获取udp累计发送的数据包个数
+     */
+    static uint64_t getUdpSendPackets();
+
+    /**
+     * 获取udp发送累计的系统调用次数，与getUdpSendPackets()相除即为单次系统调用发送的平均数据包个数
+     */
+    static uint64_t getUdpSendSyscalls();
+
+    /**
+     * 跳过已经在外部发送的字节，发送完毕的数据包会触发发送成功回调
+     * @param n 已发送的字节数
+     * @param zerocopy_list 不为空时发送完毕的数据包转移至该列队，而不是立即回收
+     */
+    void reOffset(size_t n, List<BufferSock::Ptr> *zerocopy_list = nullptr);
 
 private:
-    void reOffset(size_t n);
-    ssize_t send_l(int fd, int flags, bool udp);
+    ssize_t send_l(int fd, int flags, bool udp, bool udp_gso, bool zerocopy);
+#if defined(__linux__) || defined(__linux)
+    ssize_t send_mmsg(int fd, int flags, bool udp_gso);
+#endif
 
 private:
+    //是否包含BufferFile文件数据
+    bool _has_file = false;
+    //是否包含展开为多个iovec的BufferChain
+    bool _has_chain = false;
     size_t _iovec_off = 0;
     size_t _remainSize = 0;
     vector<struct iovec> _iovec;
+    //包含BufferChain时有效，与_iovec一一对应，标记该iovec是否为数据包的最后一段
+    vector<bool> _iovec_end;
     List<BufferSock::Ptr> _pkt_list;
+    //第一次以MSG_ZEROCOPY方式发送时使用的列队，内核可能仍在引用之后发送完毕的数据包
+    ZeroCopyQueue::Ptr _zerocopy;
+#if defined(__linux__) || defined(__linux)
+    //与_iovec一一对应的数据包，批量发送udp时用于获取目标地址
+    vector<BufferSock *> _pkt_array;
+    vector<struct mmsghdr> _mmsgs;
+    //存放UDP_SEGMENT控制信息
+    vector<char> _control;
+    //本socket不支持UDP_SEGMENT时置位，之后不再尝试
+    bool _udp_gso_unsupported = false;
+#endif
     //对象个数统计
     ObjectStatistic<BufferList> _statistic;
 };
 
+/**
+ * socket接收缓存，同一个poller线程下的所有socket共享
+ * udp socket在linux下使用recvmmsg批量接收，一次系统调用可以读取多个数据包
+ */
+class SocketRecvBuffer : public noncopyable {
+public:
+    using Ptr = std::shared_ptr<SocketRecvBuffer>;
+
+    virtual ~SocketRecvBuffer() = default;
+
+    /**
+     * 从socket读取数据
+     * @param fd socket文件描述符
+     * @param count 读取到的数据包个数
+     * @return 读取到的总字节数，-1代表失败
+     */
+    virtual ssize_t recvFromSocket(int fd, ssize_t &count) = 0;
+
+    /**
+     * 获取第index个数据包
+     */
+    virtual Buffer::Ptr &getBuffer(size_t index) = 0;
+
+    /**
+     * 获取第index个数据包的来源地址
+     * @param addr_len 地址长度
+     */
+    virtual struct sockaddr *getAddress(size_t index, int &addr_len) = 0;
+
+    /**
+     * 创建接收缓存
+     * @param is_udp 是否为udp socket
+     * @param use_pool 是否从循环池获取接收缓存，开启后每次读取的数据包均为独立对象，
+     *                 onRead回调的使用者可以直接持有该对象而无需拷贝；此时接收缓存不能在socket间共享
+     */
+    static Ptr create(bool is_udp, bool use_pool = false);
+};
+
 }//namespace toolkit
 #endif //ZLTOOLKIT_BUFFER_H
@@ -0,0 +1,180 @@
+﻿/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/xia-chu/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <mutex>
+#include <atomic>
+#include "BufferSlab.h"
+#include "Util/util.h"
+
+namespace toolkit {
+
+//各级内存块大小
+static constexpr size_t kSlabSizes[] = {256, 2 * 1024, 16 * 1024, 64 * 1024, 256 * 1024};
+static constexpr size_t kSlabClasses = sizeof(kSlabSizes) / sizeof(kSlabSizes[0]);
+//每个线程各级最多缓存的内存块个数，超过后把一半交还全局仓库
+static constexpr size_t kSlabCacheBlocks[] = {256, 128, 32, 16, 4};
+//全局仓库各级最多保存的批数，超过后直接释放
+static constexpr size_t kSlabDepotBatches = 16;
+//全局仓库按numa节点区分的个数
+static constexpr size_t kSlabNumaNodes = 8;
+
+struct SlabCounter {
+    atomic<uint64_t> alloc{0};
+    atomic<uint64_t> cache_hit{0};
+    atomic<uint64_t> depot_hit{0};
+    atomic<uint64_t> malloc{0};
+    atomic<size_t> depot_blocks{0};
+};
+
+static SlabCounter s_counter[kSlabClasses];
+
+static size_t slabClassOf(size_t size) {
+    for (size_t i = 0; i < kSlabClasses; ++i) {
+        if (size <= kSlabSizes[i]) {
+            return i;
+        }
+    }
+    return kSlabClasses;
+}
+
+static void freeBlocks(vector<char *> &blocks) {
+    for (auto ptr : blocks) {
+        delete[] ptr;
+    }
+    blocks.clear();
+}
+
+class SlabDepot {
+public:
+    bool take(size_t cls, vector<char *> &blocks) {
+        lock_guard<mutex> lck(_mtx);
+        if (_batches.empty()) {
+            return false;
+        }
+        blocks.swap(_batches.back());
+        _batches.pop_back();
+        s_counter[cls].depot_blocks -= blocks.size();
+        return true;
+    }
+
+    void put(size_t cls, vector<char *> &blocks) {
+        {
+            lock_guard<mutex> lck(_mtx);
+            if (_batches.size() < kSlabDepotBatches) {
+                s_counter[cls].depot_blocks += blocks.size();
+                _batches.emplace_back(std::move(blocks));
+                blocks.clear();
+                return;
+            }
+        }
+        //仓库已满
+        freeBlocks(blocks);
+    }
+
+private:
+    mutex _mtx;
+    vector<vector<char *> > _batches;
+};
+
+static SlabDepot &getSlabDepot(size_t cls) {
+    //不析构，防止静态对象析构后仍有内存回收
+    static SlabDepot *s_depots = new SlabDepot[kSlabNumaNodes * kSlabClasses];
+    auto node = getThreadNumaNode() % kSlabNumaNodes;
+    return s_depots[node * kSlabClasses + cls];
+}
+
+//线程退出时缓存已经析构，此后的分配与回收直接使用系统内存
+static thread_local bool s_slab_destroyed = false;
+
+class SlabCache {
+public:
+    ~SlabCache() {
+        s_slab_destroyed = true;
+        for (size_t i = 0; i < kSlabClasses; ++i) {
+            if (!_blocks[i].empty()) {
+                getSlabDepot(i).put(i, _blocks[i]);
+            }
+        }
+    }
+
+    char *obtain(size_t cls) {
+        auto &counter = s_counter[cls];
+        auto &blocks = _blocks[cls];
+        if (!blocks.empty()) {
+            counter.cache_hit.fetch_add(1, memory_order_relaxed);
+        } else if (getSlabDepot(cls).take(cls, blocks)) {
+            counter.depot_hit.fetch_add(1, memory_order_relaxed);
+        } else {
+            counter.malloc.fetch_add(1, memory_order_relaxed);
+            return new char[kSlabSizes[cls]];
+        }
+        auto ret = blocks.back();
+        blocks.pop_back();
+        return ret;
+    }
+
+    void recycle(size_t cls, char *ptr) {
+        auto &blocks = _blocks[cls];
+        if (blocks.size() >= kSlabCacheBlocks[cls]) {
+            //缓存已满，把一半交还全局仓库
+            auto half = kSlabCacheBlocks[cls] / 2;
+            vector<char *> batch(blocks.end() - half, blocks.end());
+            blocks.resize(blocks.size() - half);
+            getSlabDepot(cls).put(cls, batch);
+        }
+        blocks.emplace_back(ptr);
+    }
+
+private:
+    vector<char *> _blocks[kSlabClasses];
+};
+
+static thread_local SlabCache s_slab_cache;
+
+char *BufferSlab::alloc(size_t size, size_t &capacity) {
+    auto cls = slabClassOf(size);
+    if (cls == kSlabClasses) {
+        capacity = size;
+        return new char[size];
+    }
+    capacity = kSlabSizes[cls];
+    s_counter[cls].alloc.fetch_add(1, memory_order_relaxed);
+    if (s_slab_destroyed) {
+        s_counter[cls].malloc.fetch_add(1, memory_order_relaxed);
+        return new char[capacity];
+    }
+    return s_slab_cache.obtain(cls);
+}
+
+void BufferSlab::free(char *ptr, size_t capacity) {
+    auto cls = slabClassOf(capacity);
+    if (cls == kSlabClasses || s_slab_destroyed) {
+        delete[] ptr;
+        return;
+    }
+    s_slab_cache.recycle(cls, ptr);
+}
+
+vector<BufferSlab::Statistic> BufferSlab::getStatistic() {
+    vector<Statistic> ret(kSlabClasses);
+    for (size_t i = 0; i < kSlabClasses; ++i) {
+        auto &counter = s_counter[i];
+        auto &item = ret[i];
+        item.block_size = kSlabSizes[i];
+        item.alloc = counter.alloc.load(memory_order_relaxed);
+        item.cache_hit = counter.cache_hit.load(memory_order_relaxed);
+        item.depot_hit = counter.depot_hit.load(memory_order_relaxed);
+        item.malloc = counter.malloc.load(memory_order_relaxed);
+        item.depot_blocks = counter.depot_blocks.load(memory_order_relaxed);
+    }
+    return ret;
+}
+
+} /* namespace toolkit */
@@ -0,0 +1,66 @@
+﻿/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/xia-chu/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLTOOLKIT_BUFFERSLAB_H
+#define ZLTOOLKIT_BUFFERSLAB_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+using namespace std;
+
+namespace toolkit {
+
+/**
+ * BufferRaw数据内存的分级slab分配器
+ * 内存块按256B/2K/16K/64K/256K分级，每个线程缓存一定数量的各级空闲内存块，分配与回收通常不需要加锁与malloc；
+ * 线程缓存满了或空了时，与全局仓库按批交换内存块，全局仓库按numa节点区分
+ * 超过最大分级的内存直接向系统申请
+ */
+class BufferSlab {
+public:
+    //单个分级的统计信息
+    struct Statistic {
+        //该级内存块大小
+        size_t block_size;
+        //累计分配次数，等于cache_hit + depot_hit + malloc
+        uint64_t alloc;
+        //线程缓存命中次数
+        uint64_t cache_hit;
+        //线程缓存为空时从全局仓库批量获取的次数
+        uint64_t depot_hit;
+        //向系统申请内存块的次数
+        uint64_t malloc;
+        //全局仓库中的空闲内存块个数
+        size_t depot_blocks;
+    };
+
+    /**
+     * 分配内存
+     * @param size 请求的字节数
+     * @param capacity 返回实际可用的字节数，即所属分级的内存块大小，超过最大分级时等于size
+     */
+    static char *alloc(size_t size, size_t &capacity);
+
+    /**
+     * 回收alloc分配的内存
+     * @param ptr 内存地址
+     * @param capacity alloc返回的实际可用字节数
+     */
+    static void free(char *ptr, size_t capacity);
+
+    /**
+     * 获取各分级的统计信息，统计值为原子计数的快照
+     */
+    static vector<Statistic> getStatistic();
+};
+
+} /* namespace toolkit */
+#endif //ZLTOOLKIT_BUFFERSLAB_H
@@ -17,6 +17,10 @@
 #include "Thread/semaphore.h"
 #include "Poller/EventPoller.h"
 #include "Thread/WorkThreadPool.h"
+
+#if defined(__linux__) || defined(__linux)
+#include <linux/errqueue.h>
+#endif
 using namespace std;
 
 #define LOCK_GUARD(mtx) lock_guard<decltype(mtx)> lck(mtx)
@@ -55,6 +59,7 @@ Socket::Ptr Socket::createSocket(const EventPoller::Ptr &poller, bool enable_mut
 Socket::Socket(const EventPoller::Ptr &poller, bool enable_mutex) :
         _mtx_sock_fd(enable_mutex), _mtx_event(enable_mutex),
         _mtx_send_buf_waiting(enable_mutex), _mtx_send_buf_sending(enable_mutex){
+    _poller_only = !enable_mutex;
 
     _poller = poller;
     if (!_poller) {
@@ -65,10 +70,32 @@ Socket::Socket(const EventPoller::Ptr &poller, bool enable_mutex) :
     setOnAccept(nullptr);
     setOnFlush(nullptr);
     setOnBeforeAccept(nullptr);
+    setOnWatermark(nullptr);
 }
 
 Socket::~Socket() {
     closeSock();
+    //此时已没有其他线程访问本对象
+    releaseZeroCopy();
+    if (!_send_buf_sending.empty() && _send_buf_sending.front()->isZeroCopyUsed() && !_poller->isCurrentThread()) {
+        //零拷贝列队只能在poller线程中访问，未发送完毕的数据包切换至poller线程中交由其回收
+        auto sending = std::make_shared<List<BufferList::Ptr> >();
+        sending->swap(_send_buf_sending);
+        _poller->async([sending]() {});
+    }
+    //恢复被本socket暂停接收的关联socket
+    for (auto &pr : _backpressure_socks) {
+        auto sock = pr.first.lock();
+        if (!sock || !pr.second) {
+            continue;
+        }
+        weak_ptr<Socket> weak_sock = sock;
+        sock->getPoller()->async([weak_sock]() {
+            if (auto strong_sock = weak_sock.lock()) {
+                strong_sock->applyBackpressure(false);
+            }
+        });
+    }
 }
 
 void Socket::setOnRead(onReadCB cb) {
@@ -93,6 +120,11 @@ void Socket::setOnErr(onErrCB cb) {
     }
 }
 
+Socket::onErrCB Socket::getOnErr() {
+    LOCK_GUARD(_mtx_event);
+    return _on_err;
+}
+
 void Socket::setOnAccept(onAcceptCB cb) {
     LOCK_GUARD(_mtx_event);
     if (cb) {
@@ -113,6 +145,15 @@ void Socket::setOnFlush(onFlush cb) {
     }
 }
 
+void Socket::setOnWatermark(onWatermark cb) {
+    LOCK_GUARD(_mtx_event);
+    if (cb) {
+        _on_watermark = std::move(cb);
+    } else {
+        _on_watermark = [](bool) {};
+    }
+}
+
 void Socket::setOnBeforeAccept(onCreateSocket cb){
     LOCK_GUARD(_mtx_event);
     if (cb) {
@@ -177,6 +218,7 @@ void Socket::connect(const string &url, uint16_t port, onErrCB con_cb_in, float
         //保存fd
         LOCK_GUARD(strong_self->_mtx_sock_fd);
         strong_self->_sock_fd = sock_fd;
+        ++strong_self->_sock_fd_serial;
     });
 
     auto poller = _poller;
@@ -229,7 +271,15 @@ bool Socket::attachEvent(const SockFD::Ptr &sock, bool is_udp) {
     weak_ptr<Socket> weak_self = shared_from_this();
     weak_ptr<SockFD> weak_sock = sock;
     _enable_recv = true;
-    _read_buffer = _poller->getSharedBuffer();
+    _read_buffer = _enable_recv_pool ? SocketRecvBuffer::create(is_udp, true) : _poller->getSharedBuffer(is_udp);
+    //新的fd，内核零拷贝序号从0开始；原fd上未完成的零拷贝发送继续等待其通知
+    releaseZeroCopy();
+    if (_enable_zerocopy && !is_udp) {
+        attachZeroCopy(sock);
+    }
+    if (auto busy_poll = _poller->getSocketBusyPoll()) {
+        SockUtil::setBusyPoll(sock->rawFd(), (int) busy_poll);
+    }
     int result = _poller->addEvent(sock->rawFd(), Event_Read | Event_Error | Event_Write, [weak_self,weak_sock,is_udp](int event) {
         auto strong_self = weak_self.lock();
         auto strong_sock = weak_sock.lock();
@@ -244,29 +294,115 @@ bool Socket::attachEvent(const SockFD::Ptr &sock, bool is_udp) {
             strong_self->onWriteAble(strong_sock);
         }
         if (event & Event_Error) {
-            strong_self->emitErr(getSockErr(strong_sock));
+            if (!strong_self->onErrQueue(strong_sock)) {
+                strong_self->emitErr(getSockErr(strong_sock));
+            }
         }
     });
 
     return -1 != result;
 }
 
-ssize_t Socket::onRead(const SockFD::Ptr &sock, bool is_udp) noexcept{
-    ssize_t ret = 0, nread = 0;
-    auto sock_fd = sock->rawFd();
+void Socket::attachZeroCopy(const SockFD::Ptr &sock) {
+    if (-1 == SockUtil::setZeroCopy(sock->rawFd())) {
+        WarnL << "开启零拷贝发送失败:" << get_uv_errmsg(true);
+        return;
+    }
+    if (!_zerocopy) {
+        //同一个fd重新开启时保留原列队，内核的发送序号不会重置，原列队中的数据包仍在等待通知
+        _zerocopy = std::make_shared<ZeroCopyQueue>();
+        _zerocopy_num = sock->sockNum();
+    }
+}
 
-    auto data = _read_buffer->data();
-    //最后一个字节设置为'\0'
-    auto capacity = _read_buffer->getCapacity() - 1;
+#if defined(SO_EE_ORIGIN_ZEROCOPY)
+//读取零拷贝发送完成的通知，返回是否读取到通知
+static bool readZeroCopyNotify(int fd, ZeroCopyQueue &queue) {
+    //零拷贝发送完成的通知通过错误列队返回
+    bool has_notify = false;
+    char control[128];
+    while (true) {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        auto ret = recvmsg(fd, &msg, MSG_ERRQUEUE);
+        if (-1 == ret) {
+            if (UV_EINTR == get_uv_error(true)) {
+                continue;
+            }
+            break;
+        }
+        for (auto cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+                  (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))) {
+                continue;
+            }
+            auto serr = (struct sock_extended_err *) CMSG_DATA(cm);
+            if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                continue;
+            }
+            queue.onComplete(serr->ee_info, serr->ee_data, serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED);
+            has_notify = true;
+        }
+    }
+    return has_notify;
+}
+#endif
+
+//替换fd或销毁socket后，等待原fd零拷贝发送完成通知的最长时间
+static constexpr uint64_t kZeroCopyDrainMS = 3000;
+//等待期间读取原fd错误列队的间隔
+static constexpr uint64_t kZeroCopyDrainIntervalMS = 10;
+
+void Socket::releaseZeroCopy() {
+#if defined(SO_EE_ORIGIN_ZEROCOPY)
+    if (_zerocopy && _zerocopy->size() && _zerocopy_num) {
+        //内核可能还在读取这些数据包的内存，不能立即释放；保持原fd打开并定时读取其错误列队，直到全部完成或超时
+        auto queue = std::move(_zerocopy);
+        auto num = std::move(_zerocopy_num);
+        Ticker ticker;
+        _poller->doDelayTask(kZeroCopyDrainIntervalMS, [queue, num, ticker]() -> uint64_t {
+            readZeroCopyNotify(num->rawFd(), *queue);
+            if (!queue->size()) {
+                return 0;
+            }
+            if (ticker.elapsedTime() > kZeroCopyDrainMS) {
+                WarnL << "等待零拷贝发送完成通知超时，剩余未完成的发送次数:" << queue->size();
+                return 0;
+            }
+            return kZeroCopyDrainIntervalMS;
+        });
+    }
+#endif
+    _zerocopy = nullptr;
+    _zerocopy_num = nullptr;
+}
 
-    struct sockaddr addr;
-    socklen_t len = sizeof(struct sockaddr);
+bool Socket::onErrQueue(const SockFD::Ptr &sock) {
+#if defined(SO_EE_ORIGIN_ZEROCOPY)
+    if (!_zerocopy || !readZeroCopyNotify(sock->rawFd(), *_zerocopy)) {
+        return false;
+    }
+    //确认socket本身没有发生异常
+    int error = 0;
+    socklen_t len = sizeof(error);
+    getsockopt(sock->rawFd(), SOL_SOCKET, SO_ERROR, (char *) &error, &len);
+    if (error) {
+        emitErr(toSockException(uv_translate_posix_error(error)));
+    }
+    return true;
+#else
+    return false;
+#endif
+}
 
-    while (_enable_recv) {
-        do {
-            nread = recvfrom(sock_fd, data, capacity, 0, &addr, &len);
-        } while (-1 == nread && UV_EINTR == get_uv_error(true));
+ssize_t Socket::onRead(const SockFD::Ptr &sock, bool is_udp) noexcept{
+    ssize_t ret = 0, nread = 0, count = 0;
+    auto sock_fd = sock->rawFd();
 
+    while (_enable_recv && !_backpressure_count) {
+        nread = _read_buffer->recvFromSocket(sock_fd, count);
         if (nread == 0) {
             if (!is_udp) {
                 emitErr(SockException(Err_eof, "end of file"));
@@ -283,17 +419,19 @@ ssize_t Socket::onRead(const SockFD::Ptr &sock, bool is_udp) noexcept{
         }
 
         ret += nread;
-        data[nread] = '\0';
-        //设置buffer有效数据大小
-        _read_buffer->setSize(nread);
-
         //触发回调
         LOCK_GUARD(_mtx_event);
-        try {
+        //udp socket可能一次读取到多个数据包，逐个触发回调
+        for (ssize_t i = 0; i < count; ++i) {
             //此处捕获异常，目的是防止数据未读尽，epoll边沿触发失效的问题
-            _on_read(_read_buffer, &addr, len);
-        } catch (std::exception &ex) {
-            ErrorL << "触发socket on_read事件时,捕获到异常:" << ex.what();
+            //每个数据包单独捕获，防止某个数据包的回调抛异常导致同批次后续数据包被丢弃
+            try {
+                int addr_len;
+                auto addr = _read_buffer->getAddress(i, addr_len);
+                _on_read(_read_buffer->getBuffer(i), addr, addr_len);
+            } catch (std::exception &ex) {
+                ErrorL << "触发socket on_read事件时,捕获到异常:" << ex.what();
+            }
         }
     }
     return 0;
@@ -316,6 +454,7 @@ bool Socket::emitErr(const SockException& err) noexcept{
         if (!strong_self) {
             return;
         }
+        strong_self->resetSendBuffer();
         LOCK_GUARD(strong_self->_mtx_event);
         try {
             strong_self->_on_err(err);
@@ -347,6 +486,29 @@ ssize_t Socket::send(Buffer::Ptr buf, struct sockaddr *addr, socklen_t addr_len,
     return send(std::make_shared<BufferSock>(std::move(buf), addr, addr_len), try_flush);
 }
 
+ssize_t Socket::sendFile(int fd, uint64_t offset, size_t size, BufferSock::onResult cb, bool try_flush) {
+#if !defined(_WIN32)
+    {
+        LOCK_GUARD(_mtx_sock_fd);
+        if (!_sock_fd || _sock_fd->type() != SockNum::Sock_TCP) {
+            //只支持tcp socket
+            return -1;
+        }
+    }
+    if (!size) {
+        return 0;
+    }
+    auto file = BufferFile::create(fd, offset, size);
+    if (!file) {
+        return -1;
+    }
+    return send(std::make_shared<BufferSock>(std::move(file), nullptr, 0, std::move(cb)), try_flush);
+#else
+    WarnL << "windows下不支持sendFile";
+    return -1;
+#endif
+}
+
 ssize_t Socket::send(BufferSock::Ptr buf, bool try_flush) {
     auto size = buf ? buf->size() : 0;
     if (!size) {
@@ -354,9 +516,11 @@ ssize_t Socket::send(BufferSock::Ptr buf, bool try_flush) {
     }
 
     SockFD::Ptr sock;
+    uint32_t serial;
     {
         LOCK_GUARD(_mtx_sock_fd);
         sock = _sock_fd;
+        serial = _sock_fd_serial;
     }
 
     if (!sock) {
@@ -364,12 +528,60 @@ ssize_t Socket::send(BufferSock::Ptr buf, bool try_flush) {
         return -1;
     }
 
+    if (_poller_only && !_poller->isCurrentThread()) {
+        //未启用互斥锁时不能跨线程访问发送缓存，通过poller的任务节点列队转交数据，通常不需要任何内存分配
+        //转交中的数据也计入发送缓存字节数，使高低水位包含这部分数据
+        uint32_t epoch = _send_buf_epoch;
+        addSendBytes(size);
+        weak_ptr<Socket> weak_self = shared_from_this();
+        auto task = [weak_self, buf, epoch, serial, try_flush]() mutable {
+            auto strong_self = weak_self.lock();
+            if (!strong_self) {
+                return;
+            }
+            SockFD::Ptr cur_sock;
+            uint32_t cur_serial;
+            {
+                LOCK_GUARD(strong_self->_mtx_sock_fd);
+                cur_sock = strong_self->_sock_fd;
+                cur_serial = strong_self->_sock_fd_serial;
+            }
+            if (!cur_sock || cur_serial != serial) {
+                //转交期间连接已断开或已重连，丢弃数据；发送缓存尚未因断开而清零时扣除转交时计入的字节数
+                if (strong_self->_send_buf_epoch == epoch) {
+                    strong_self->subSendBytes(buf->size());
+                }
+                return;
+            }
+            strong_self->send_l(cur_sock, std::move(buf), try_flush);
+        };
+        static_assert(sizeof(task) <= TaskNode::kInlineSize, "cross-thread send task should be stored inline");
+        _poller->post(std::move(task), false);
+        return size;
+    }
+
+    addSendBytes(size);
+    return send_l(sock, std::move(buf), try_flush);
+}
+
+ssize_t Socket::send_l(const SockFD::Ptr &sock, BufferSock::Ptr buf, bool try_flush) {
+    auto size = buf->size();
+    if (_poller_only && try_flush && !_send_coalesce && _sendable && _send_buf_waiting.empty() && _send_buf_sending.empty()
+        && sock->type() == SockNum::Sock_TCP && !buf->chain() && buf->data() && (!_enable_zerocopy || size < _zerocopy_threshold)) {
+        //发送缓存为空，跳过列队直接写socket
+        return sendDirect(sock, std::move(buf)) ? size : -1;
+    }
+
     {
         LOCK_GUARD(_mtx_send_buf_waiting);
         _send_buf_waiting.emplace_back(std::move(buf));
     }
 
     if(try_flush){
+        if (_send_coalesce && _poller->isCurrentThread() && !coalesceSend(size)) {
+            //等待本轮poller循环结束时合并发送
+            return size;
+        }
         if (_sendable) {
             //该socket可写
             return flushData(sock, false) ? size : -1;
@@ -421,6 +633,125 @@ size_t Socket::getSendBufferCount(){
     return ret;
 }
 
+size_t Socket::getSendBufferBytes() const {
+    return _send_buf_bytes.load(memory_order_relaxed);
+}
+
+void Socket::setSendWatermark(size_t high, size_t low) {
+    _low_watermark.store(low, memory_order_relaxed);
+    _high_watermark.store(high, memory_order_relaxed);
+}
+
+void Socket::addBackpressureSocket(const Socket::Ptr &sock) {
+    LOCK_GUARD(_mtx_event);
+    _backpressure_socks.emplace_back(sock, false);
+}
+
+void Socket::addSendBytes(size_t n) {
+    auto bytes = _send_buf_bytes += n;
+    auto high = _high_watermark.load(memory_order_relaxed);
+    if (high && bytes >= high && !_above_watermark.exchange(true)) {
+        notifyWatermark();
+    }
+}
+
+void Socket::subSendBytes(size_t n) {
+    if (!n) {
+        return;
+    }
+    auto bytes = _send_buf_bytes -= n;
+    if (bytes <= _low_watermark.load(memory_order_relaxed) && _above_watermark.load(memory_order_relaxed) && _above_watermark.exchange(false)) {
+        notifyWatermark();
+    }
+}
+
+void Socket::resetSendBuffer() {
+    {
+        LOCK_GUARD(_mtx_sock_fd);
+        if (_sock_fd) {
+            //触发错误后已经重新连接，发送缓存属于新连接
+            return;
+        }
+    }
+    //连接已断开，丢弃尚未发送的数据，否则发送缓存字节数无法回落，关联的socket将一直暂停接收
+    {
+        LOCK_GUARD(_mtx_send_buf_waiting);
+        _send_buf_waiting.clear();
+    }
+    {
+        LOCK_GUARD(_mtx_send_buf_sending);
+        _send_buf_sending.clear();
+    }
+    _send_buf_bytes = 0;
+    ++_send_buf_epoch;
+    if (_above_watermark.exchange(false)) {
+        //本函数在poller线程中执行，可以同步通知
+        onWatermarkChanged();
+    }
+}
+
+void Socket::notifyWatermark() {
+    //不能同步执行，回调中可能再次发送数据，而本函数可能正在flushData中被调用
+    weak_ptr<Socket> weak_self = shared_from_this();
+    _poller->async([weak_self]() {
+        if (auto strong_self = weak_self.lock()) {
+            strong_self->onWatermarkChanged();
+        }
+    }, false);
+}
+
+void Socket::onWatermarkChanged() {
+    //多个线程可能交替越过水位，这里只根据最新的状态通知
+    bool high = _above_watermark;
+    if (high == _watermark_notified) {
+        return;
+    }
+    _watermark_notified = high;
+    LOCK_GUARD(_mtx_event);
+    for (auto it = _backpressure_socks.begin(); it != _backpressure_socks.end();) {
+        auto sock = it->first.lock();
+        if (!sock) {
+            it = _backpressure_socks.erase(it);
+            continue;
+        }
+        if (it->second == high) {
+            //高水位后才关联的socket尚未被暂停，无需恢复
+            ++it;
+            continue;
+        }
+        it->second = high;
+        //关联的socket可能属于其他poller，切换至其poller线程暂停或恢复接收
+        weak_ptr<Socket> weak_sock = sock;
+        sock->getPoller()->async([weak_sock, high]() {
+            if (auto strong_sock = weak_sock.lock()) {
+                strong_sock->applyBackpressure(high);
+            }
+        });
+        ++it;
+    }
+    _on_watermark(high);
+}
+
+void Socket::applyBackpressure(bool pause) {
+    if (pause) {
+        if (_backpressure_count++) {
+            //已被其他关联的socket暂停
+            return;
+        }
+    } else if (!_backpressure_count || --_backpressure_count) {
+        //仍被其他关联的socket暂停
+        return;
+    }
+    SockFD::Ptr sock;
+    {
+        LOCK_GUARD(_mtx_sock_fd);
+        sock = _sock_fd;
+    }
+    if (sock) {
+        updateEvent(sock);
+    }
+}
+
 uint64_t Socket::elapsedTimeAfterFlushed(){
     return _send_flush_ticker.elapsedTime();
 }
@@ -430,7 +761,8 @@ bool Socket::listen(const SockFD::Ptr &sock){
     weak_ptr<SockFD> weak_sock = sock;
     weak_ptr<Socket> weak_self = shared_from_this();
     _enable_recv = true;
-    int result = _poller->addEvent(sock->rawFd(), Event_Read | Event_Error, [weak_self, weak_sock](int event) {
+    //listen fd可能被克隆至多个poller，新连接只唤醒其中一个poller，避免惊群
+    int result = _poller->addEvent(sock->rawFd(), Event_Read | Event_Error | Event_Exclusive, [weak_self, weak_sock](int event) {
         auto strong_self = weak_self.lock();
         auto strong_sock = weak_sock.lock();
         if (!strong_self || !strong_sock) {
@@ -445,6 +777,7 @@ bool Socket::listen(const SockFD::Ptr &sock){
 
     LOCK_GUARD(_mtx_sock_fd);
     _sock_fd = sock;
+    ++_sock_fd_serial;
     return true;
 }
 
@@ -468,6 +801,7 @@ bool Socket::bindUdpSock(uint16_t port, const string &local_ip) {
     }
     LOCK_GUARD(_mtx_sock_fd);
     _sock_fd = sock;
+    ++_sock_fd_serial;
     return true;
 }
 
@@ -476,7 +810,12 @@ int Socket::onAccept(const SockFD::Ptr &sock, int event) noexcept {
     while (true) {
         if (event & Event_Read) {
             do {
+#if defined(__linux__)
+                //一次系统调用同时设置非阻塞与close-on-exec
+                fd = accept4(sock->rawFd(), NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
                 fd = (int)accept(sock->rawFd(), NULL, NULL);
+#endif
             } while (-1 == fd && UV_EINTR == get_uv_error(true));
 
             if (fd == -1) {
@@ -491,6 +830,8 @@ int Socket::onAccept(const SockFD::Ptr &sock, int event) noexcept {
                 return -1;
             }
 
+#if !defined(__linux__)
+            //linux下这些选项在SockUtil::listen中已设置在监听socket上，由accept出的socket继承
             SockUtil::setNoSigpipe(fd);
             SockUtil::setNoBlocked(fd);
             SockUtil::setNoDelay(fd);
@@ -498,6 +839,7 @@ int Socket::onAccept(const SockFD::Ptr &sock, int event) noexcept {
             SockUtil::setRecvBuf(fd);
             SockUtil::setCloseWait(fd);
             SockUtil::setCloExec(fd);
+#endif
 
             Socket::Ptr peer_sock;
             {
@@ -554,6 +896,7 @@ SockFD::Ptr Socket::setPeerSock(int fd) {
     auto sock = makeSock(fd, SockNum::Sock_TCP);
     LOCK_GUARD(_mtx_sock_fd);
     _sock_fd = sock;
+    ++_sock_fd_serial;
     return sock;
 }
 
@@ -594,6 +937,84 @@ string Socket::getIdentifier() const{
     return class_name + to_string(reinterpret_cast<uint64_t>(this));
 }
 
+bool Socket::sendDirect(const SockFD::Ptr &sock, BufferSock::Ptr buf) {
+    auto size = buf->size();
+    ssize_t n;
+    do {
+        n = ::send(sock->rawFd(), buf->data(), size, _sock_flags);
+    } while (-1 == n && UV_EINTR == get_uv_error(true));
+    if (n > 0) {
+        subSendBytes(n);
+    }
+
+    if (n == (ssize_t) size) {
+        //全部发送成功
+        buf->onSendSuccess();
+        _send_flush_ticker.resetTime();
+        return true;
+    }
+
+    if (n < 0) {
+        int err = get_uv_error(true);
+        if (err != UV_EAGAIN) {
+            emitErr(toSockException(err));
+            return false;
+        }
+        n = 0;
+    }
+
+    //部分发送成功或socket写缓存已满，剩余数据放入二级缓存并等待可写事件
+    List<BufferSock::Ptr> list;
+    list.emplace_back(std::move(buf));
+    auto packet = std::make_shared<BufferList>(list);
+    if (n) {
+        packet->reOffset(n);
+    }
+    _send_buf_sending.emplace_back(std::move(packet));
+    startWriteAbleEvent(sock);
+    return true;
+}
+
+bool Socket::coalesceSend(size_t size) {
+    _coalesce_bytes += size;
+    if (_coalesce_bytes >= _coalesce_max_bytes) {
+        //累积数据达到阈值，立即写socket
+        _coalesce_bytes = 0;
+        return true;
+    }
+    if (!_coalesce_pending) {
+        _coalesce_pending = true;
+        weak_ptr<Socket> weak_self = shared_from_this();
+        _poller->runAtLoopEnd([weak_self]() {
+            if (auto strong_self = weak_self.lock()) {
+                strong_self->flushCoalesced();
+            }
+        });
+    }
+    return false;
+}
+
+void Socket::flushCoalesced() {
+    _coalesce_pending = false;
+    _coalesce_bytes = 0;
+    SockFD::Ptr sock;
+    {
+        LOCK_GUARD(_mtx_sock_fd);
+        sock = _sock_fd;
+    }
+    if (!sock) {
+        return;
+    }
+    if (_sendable) {
+        flushData(sock, false);
+        return;
+    }
+    //该socket不可写，可写事件触发时会继续发送，这里只判断发送超时
+    if (_send_flush_ticker.elapsedTime() > _max_send_buffer_ms) {
+        emitErr(SockException(Err_other, "socket send timeout"));
+    }
+}
+
 bool Socket::flushData(const SockFD::Ptr &sock, bool poller_thread) {
     decltype(_send_buf_sending) send_buf_sending_tmp;
     {
@@ -612,7 +1033,7 @@ bool Socket::flushData(const SockFD::Ptr &sock, bool poller_thread) {
                 LOCK_GUARD(_mtx_send_buf_waiting);
                 if (!_send_buf_waiting.empty()) {
                     //把一级缓中数数据放置到二级缓存中并清空
-                    send_buf_sending_tmp.emplace_back(std::make_shared<BufferList>(_send_buf_waiting));
+                    send_buf_sending_tmp.emplace_back(std::make_shared<BufferList>(_send_buf_waiting, sock->type() == SockNum::Sock_UDP));
                     break;
                 }
             }
@@ -629,9 +1050,24 @@ bool Socket::flushData(const SockFD::Ptr &sock, bool poller_thread) {
 
     int fd = sock->rawFd();
     bool is_udp = sock->type() == SockNum::Sock_UDP;
+    //零拷贝列队只能在poller线程中访问
+    bool is_poller = _poller->isCurrentThread();
+    bool zerocopy_enabled = !is_udp && is_poller && _enable_zerocopy && _zerocopy && !_zerocopy->isCopied();
     while (!send_buf_sending_tmp.empty()) {
         auto &packet = send_buf_sending_tmp.front();
-        auto n = packet->send(fd, _sock_flags, is_udp);
+        if (!is_poller && packet->isZeroCopyUsed()) {
+            //发送完毕的数据包需要交由零拷贝列队回收，所以留给poller线程在可写时发送
+            break;
+        }
+        auto zerocopy = zerocopy_enabled && packet->remainSize() >= _zerocopy_threshold ? _zerocopy : nullptr;
+        auto remain = packet->remainSize();
+        auto n = packet->send(fd, _sock_flags, is_udp, _enable_udp_gso, zerocopy);
+        //可能只发送了部分数据，所以按剩余字节数的变化统计
+        subSendBytes(remain - packet->remainSize());
+        if (packet->isUdpGsoUnsupported() && _enable_udp_gso.exchange(false)) {
+            //只关闭本socket的udp gso，其他socket的路由或网卡可能支持
+            WarnL << "UDP_SEGMENT不可用，该socket的udp gso功能已关闭";
+        }
         if (n > 0) {
             //全部或部分发送成功
             if (packet->empty()) {
@@ -640,10 +1076,6 @@ bool Socket::flushData(const SockFD::Ptr &sock, bool poller_thread) {
                 continue;
             }
             //部分发送成功
-            if (!poller_thread) {
-                //如果该函数是poller线程触发的，那么该socket应该已经加入了可写事件的监听，所以我们不需要再次加入监听
-                startWriteAbleEvent(sock);
-            }
             break;
         }
 
@@ -651,10 +1083,6 @@ bool Socket::flushData(const SockFD::Ptr &sock, bool poller_thread) {
         int err = get_uv_error(true);
         if (err == UV_EAGAIN) {
             //等待下一次发送
-            if (!poller_thread) {
-                //如果该函数是poller线程触发的，那么该socket应该已经加入了可写事件的监听，所以我们不需要再次加入监听
-                startWriteAbleEvent(sock);
-            }
             break;
         }
         //其他错误代码，发生异常
@@ -665,10 +1093,17 @@ bool Socket::flushData(const SockFD::Ptr &sock, bool poller_thread) {
     //回滚未发送完毕的数据
     if (!send_buf_sending_tmp.empty()) {
         //有剩余数据
-        LOCK_GUARD(_mtx_send_buf_sending);
-        send_buf_sending_tmp.swap(_send_buf_sending);
-        _send_buf_sending.append(send_buf_sending_tmp);
-        //二级缓存未全部发送完毕，说明该socket不可写，直接返回
+        {
+            LOCK_GUARD(_mtx_send_buf_sending);
+            send_buf_sending_tmp.swap(_send_buf_sending);
+            _send_buf_sending.append(send_buf_sending_tmp);
+        }
+        //二级缓存未全部发送完毕，说明该socket不可写，等待可写事件
+        //在回滚数据之后再开始等待，确保可写事件回调时能看到剩余数据
+        if (!poller_thread) {
+            //如果该函数是poller线程触发的，那么该socket应该已经加入了可写事件的监听，所以我们不需要再次加入监听
+            startWriteAbleEvent(sock);
+        }
         return true;
     }
 
@@ -678,6 +1113,10 @@ bool Socket::flushData(const SockFD::Ptr &sock, bool poller_thread) {
 }
 
 void Socket::onWriteAble(const SockFD::Ptr &sock) {
+    if (_edge_write && _sendable) {
+        //一直监听可写事件时，每次读事件也会带上可写事件；可写标记未清除说明没有等待可写的数据
+        return;
+    }
     bool empty_waiting;
     bool empty_sending;
     {
@@ -702,15 +1141,55 @@ void Socket::onWriteAble(const SockFD::Ptr &sock) {
 void Socket::startWriteAbleEvent(const SockFD::Ptr &sock) {
     //开始监听socket可写事件
     _sendable = false;
-    int flag = _enable_recv ? Event_Read : 0;
-    _poller->modifyEvent(sock->rawFd(), flag | Event_Error | Event_Write);
+    if (_edge_write) {
+        //可写事件一直处于监听状态，无需修改
+        if (!_poller->isCurrentThread()) {
+            //可写边沿可能在本线程发送失败后、清除可写标记前已经触发，所以切换至poller线程重新尝试发送
+            //poller线程发送失败后的可写边沿必定在之后的事件轮询中触发
+            weak_ptr<Socket> weak_self = shared_from_this();
+            weak_ptr<SockFD> weak_sock = sock;
+            _poller->async([weak_self, weak_sock]() {
+                auto strong_self = weak_self.lock();
+                auto strong_sock = weak_sock.lock();
+                if (strong_self && strong_sock) {
+                    strong_self->onWriteAble(strong_sock);
+                }
+            }, false);
+        }
+        return;
+    }
+    updateEvent(sock);
 }
 
 void Socket::stopWriteAbleEvent(const SockFD::Ptr &sock) {
     //停止监听socket可写事件
     _sendable = true;
-    int flag = _enable_recv ? Event_Read : 0;
-    _poller->modifyEvent(sock->rawFd(), flag | Event_Error);
+    if (_edge_write) {
+        return;
+    }
+    updateEvent(sock);
+}
+
+void Socket::updateEvent(const SockFD::Ptr &sock) {
+    //读写标记可能在任意线程修改，监听事件必须在poller线程中根据最新标记计算，
+    //否则先计算、后执行的跨线程修改可能覆盖较新的修改(例如清除了刚开始监听的可写事件)
+    if (!_poller->isCurrentThread()) {
+        weak_ptr<Socket> weak_self = shared_from_this();
+        weak_ptr<SockFD> weak_sock = sock;
+        _poller->async([weak_self, weak_sock]() {
+            auto strong_self = weak_self.lock();
+            auto strong_sock = weak_sock.lock();
+            if (strong_self && strong_sock) {
+                strong_self->updateEvent(strong_sock);
+            }
+        }, false);
+        return;
+    }
+    //使用者开启接收且未被背压暂停时才监听读事件
+    int read_flag = (_enable_recv && !_backpressure_count) ? Event_Read : 0;
+    //可写时，不监听可写事件
+    int send_flag = (_sendable && !_edge_write) ? 0 : Event_Write;
+    _poller->modifyEvent(sock->rawFd(), read_flag | send_flag | Event_Error);
 }
 
 void Socket::enableRecv(bool enabled) {
@@ -718,10 +1197,14 @@ void Socket::enableRecv(bool enabled) {
         return;
     }
     _enable_recv = enabled;
-    int read_flag = _enable_recv ? Event_Read : 0;
-    //可写时，不监听可写事件
-    int send_flag = _sendable ? 0 : Event_Write;
-    _poller->modifyEvent(rawFD(), read_flag | send_flag | Event_Error);
+    SockFD::Ptr sock;
+    {
+        LOCK_GUARD(_mtx_sock_fd);
+        sock = _sock_fd;
+    }
+    if (sock) {
+        updateEvent(sock);
+    }
 }
 
 SockFD::Ptr Socket::makeSock(int sock,SockNum::SockType type){
@@ -779,6 +1262,103 @@ void Socket::setSendFlags(int flags) {
     _sock_flags = flags;
 }
 
+void Socket::enableUdpGso(bool enable) {
+    _enable_udp_gso = enable;
+}
+
+void Socket::enableRecvBufferPool(bool enable) {
+    _enable_recv_pool = enable;
+    weak_ptr<Socket> weak_self = shared_from_this();
+    _poller->async([weak_self, enable]() {
+        auto strong_self = weak_self.lock();
+        if (!strong_self || !strong_self->_read_buffer) {
+            //尚未开始监听读事件，在attachEvent时生效
+            return;
+        }
+        SockFD::Ptr sock;
+        {
+            LOCK_GUARD(strong_self->_mtx_sock_fd);
+            sock = strong_self->_sock_fd;
+        }
+        if (!sock) {
+            return;
+        }
+        //接收缓存只在poller线程中访问，在此切换是安全的
+        auto is_udp = sock->type() == SockNum::Sock_UDP;
+        strong_self->_read_buffer = enable ? SocketRecvBuffer::create(is_udp, true) : strong_self->_poller->getSharedBuffer(is_udp);
+    });
+}
+
+void Socket::enableSendCoalesce(bool enable, size_t max_bytes) {
+    weak_ptr<Socket> weak_self = shared_from_this();
+    _poller->async([weak_self, enable, max_bytes]() {
+        if (auto strong_self = weak_self.lock()) {
+            //合并发送只在poller线程中进行，在此修改配置是安全的
+            strong_self->_coalesce_max_bytes = max_bytes;
+            strong_self->_send_coalesce = enable;
+        }
+    });
+}
+
+void Socket::enableZeroCopy(bool enable, size_t threshold) {
+    weak_ptr<Socket> weak_self = shared_from_this();
+    _poller->async([weak_self, enable, threshold]() {
+        auto strong_self = weak_self.lock();
+        if (!strong_self) {
+            return;
+        }
+        //阈值只在poller线程中读写
+        strong_self->_zerocopy_threshold = threshold;
+        if (strong_self->_enable_zerocopy == enable) {
+            return;
+        }
+        strong_self->_enable_zerocopy = enable;
+        SockFD::Ptr sock;
+        {
+            LOCK_GUARD(strong_self->_mtx_sock_fd);
+            sock = strong_self->_sock_fd;
+        }
+        if (!sock || sock->type() != SockNum::Sock_TCP) {
+            //未连接的socket在连接成功后再开启
+            return;
+        }
+        if (enable) {
+            strong_self->attachZeroCopy(sock);
+        } else {
+            //已经发送的数据包仍然需要等待内核通知，所以不清空列队，只停止使用零拷贝发送
+            SockUtil::setZeroCopy(sock->rawFd(), false);
+        }
+    });
+}
+
+void Socket::enableEdgeWrite(bool enable) {
+    weak_ptr<Socket> weak_self = shared_from_this();
+    _poller->async([weak_self, enable]() {
+        auto strong_self = weak_self.lock();
+        if (!strong_self) {
+            return;
+        }
+        //水平触发的poller一直监听可写事件会导致空转
+        bool edge_write = enable && strong_self->_poller->isEdgeTriggered();
+        if (strong_self->_edge_write == edge_write) {
+            return;
+        }
+        strong_self->_edge_write = edge_write;
+        if (!strong_self->_read_buffer) {
+            //尚未开始监听读写事件，attachEvent时已经监听可写事件
+            return;
+        }
+        SockFD::Ptr sock;
+        {
+            LOCK_GUARD(strong_self->_mtx_sock_fd);
+            sock = strong_self->_sock_fd;
+        }
+        if (sock) {
+            strong_self->updateEvent(sock);
+        }
+    });
+}
+
 ///////////////SockSender///////////////////
 
 SockSender &SockSender::operator<<(const char *buf) {
@@ -906,6 +1486,13 @@ void SocketHelper::setSendFlags(int flags) {
     _sock->setSendFlags(flags);
 }
 
+void SocketHelper::setSendCoalesce(bool enable, size_t max_bytes) {
+    if (!_sock) {
+        return;
+    }
+    _sock->enableSendCoalesce(enable, max_bytes);
+}
+
 void SocketHelper::setOnCreateSocket(Socket::onCreateSocket cb){
     if (cb) {
         _on_create_socket = std::move(cb);
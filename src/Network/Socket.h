@@ -195,6 +195,10 @@ public:
         return _num->rawFd();
     }
 
+    const SockNum::Ptr &sockNum() const {
+        return _num;
+    }
+
     SockNum::SockType type() {
         return _num->type();
     }
@@ -264,11 +268,15 @@ public:
     typedef function<bool()> onFlush;
     //在接收到连接请求前，拦截Socket默认生成方式
     typedef function<Ptr(const EventPoller::Ptr &poller)> onCreateSocket;
+    //发送缓存水位变化事件，high为true代表达到高水位，false代表降到低水位
+    typedef function<void(bool high)> onWatermark;
 
     /**
      * 构造socket对象，尚未有实质操作
      * @param poller 绑定的poller线程
-     * @param enable_mutex 是否启用互斥锁(接口是否线程安全)
+     * @param enable_mutex 是否启用互斥锁(接口是否线程安全)，
+     *                     不启用时该socket只能在poller线程中操作，其他线程发送的数据会转交poller线程发送
+     *                     (转交前已断开时返回-1，转交中的数据计入发送缓存字节数)
     */
     static Ptr createSocket(const EventPoller::Ptr &poller = nullptr, bool enable_mutex = true);
     Socket(const EventPoller::Ptr &poller = nullptr, bool enable_mutex = true);
@@ -317,6 +325,11 @@ public:
      */
     virtual void setOnErr(onErrCB cb);
 
+    /**
+     * 获取当前的异常事件回调，用于在其基础上追加处理
+     */
+    onErrCB getOnErr();
+
     /**
      * 设置tcp监听接收到连接回调
      * @param cb 回调对象
@@ -364,6 +377,19 @@ public:
      */
     virtual ssize_t send(BufferSock::Ptr buf, bool try_flush = true);
 
+    /**
+     * 发送文件中的一段数据，与其他send接口共用发送列队，保证数据顺序
+     * 数据由内核直接从文件拷贝至socket，不经过用户态(linux下使用sendfile)
+     * 仅tcp socket有效，linux下sendfile无法屏蔽SIGPIPE信号，请确保已忽略该信号
+     * @param fd 文件描述符，内部会复制一份，调用后可以立即关闭
+     * @param offset 文件偏移量
+     * @param size 发送字节数
+     * @param cb 发送结果回调，参数为发送成功的字节数，0代表失败
+     * @param try_flush 是否尝试写socket
+     * @return -1代表失败(socket或文件无效)，0代表数据长度为0，否则返回数据长度
+     */
+    ssize_t sendFile(int fd, uint64_t offset, size_t size, BufferSock::onResult cb = nullptr, bool try_flush = true);
+
     /**
      * 关闭socket且触发onErr回调，onErr回调将在poller线程中进行
      * @param err 错误原因
@@ -423,6 +449,54 @@ public:
      */
     virtual void setSendFlags(int flags = SOCKET_DEFAULE_FLAGS);
 
+    /**
+     * 设置是否开启udp gso(UDP_SEGMENT)，仅linux下udp socket有效
+     * 开启后发送列队中目标地址相同、大小相同的连续数据包合并成一次发送，由内核或网卡分片
+     * 发送失败(内核、路由或网卡不支持)时自动关闭，只影响本socket
+     * @param enable 是否开启
+     */
+    virtual void enableUdpGso(bool enable = true);
+
+    /**
+     * 设置是否开启tcp零拷贝发送(SO_ZEROCOPY/MSG_ZEROCOPY)，仅linux 4.14以上有效
+     * 开启后在poller线程中发送、且单次待发送数据不小于阈值时，内核直接引用用户态内存，避免数据拷贝
+     * 数据包在内核通知发送完成后才会被释放并触发BufferSock的发送结果回调
+     * 内核退化为拷贝方式发送时(比如回环网卡)，自动停止使用零拷贝
+     * @param enable 是否开启
+     * @param threshold 待发送数据字节数阈值，小于该值时使用普通方式发送
+     */
+    virtual void enableZeroCopy(bool enable = true, size_t threshold = 16 * 1024);
+
+    /**
+     * 设置是否使用独享的接收缓存
+     * 默认同一poller线程下的所有socket共享一个接收缓存，onRead回调的数据在回调返回后即失效，使用者需要拷贝后才能持有
+     * 开启后从循环池获取接收缓存，回调的Buffer对象可以被使用者直接持有，socket会为下次读取另外获取缓存
+     * tcp接收缓存大小根据每次读取的数据量自适应调整
+     * linux下udp仍使用recvmmsg批量接收，但每个socket独享缓存，单次批量接收的数据包个数少于共享模式
+     * udp数据包直接接收至独立的2K缓存(可容纳rtp等小数据包)，无需拷贝；超过2K的数据包溢出部分写入线程共享的缓存，再合并至按实际长度分配的缓存
+     * @param enable 是否开启
+     */
+    virtual void enableRecvBufferPool(bool enable = true);
+
+    /**
+     * 设置是否一直监听可写事件(边沿触发)
+     * 默认在发送缓存满时添加可写事件监听，清空后移除，拥塞的socket每次都需要epoll_ctl修改监听
+     * 开启后可写事件一直处于监听状态，仅根据可写标记决定是否发送，在poller线程中等待可写边沿
+     * 仅在边沿触发的epoll下有效，select下忽略
+     * @param enable 是否开启
+     */
+    virtual void enableEdgeWrite(bool enable = true);
+
+    /**
+     * 设置是否合并发送
+     * 开启后在poller线程中发送的数据先暂存在发送缓存，在本轮poller循环结束或累积字节数达到阈值时一起写socket，
+     * 这样同一轮循环中的多次发送(比如头部与负载)通过一次sendmsg发出，减少tcp小包与系统调用次数
+     * 其他线程中发送的数据不受影响
+     * @param enable 是否开启
+     * @param max_bytes 累积字节数阈值，达到后立即写socket
+     */
+    virtual void enableSendCoalesce(bool enable = true, size_t max_bytes = 64 * 1024);
+
     /**
      * 关闭套接字
      */
@@ -433,6 +507,34 @@ public:
      */
     virtual size_t getSendBufferCount();
 
+    /**
+     * 获取发送缓存字节数，包括所有尚未写入socket的数据
+     */
+    virtual size_t getSendBufferBytes() const;
+
+    /**
+     * 设置发送缓存高低水位，用于背压流控
+     * 发送缓存字节数达到高水位时触发水位回调并暂停关联socket的接收，降到低水位及以下时触发回调并恢复接收
+     * 回调在poller线程中执行
+     * @param high 高水位字节数，0为关闭
+     * @param low 低水位字节数，应小于高水位
+     */
+    virtual void setSendWatermark(size_t high, size_t low);
+
+    /**
+     * 设置发送缓存水位变化事件回调
+     * @param cb 回调对象
+     */
+    virtual void setOnWatermark(onWatermark cb);
+
+    /**
+     * 关联需要背压的socket，比如代理中数据来源一端的socket
+     * 本socket发送缓存达到高水位时暂停其接收，降到低水位时恢复
+     * 背压暂停与其enableRecv设置相互独立，两者均允许时才接收；被多个socket关联时，全部恢复后才接收
+     * @param sock 关联的socket
+     */
+    virtual void addBackpressureSocket(const Socket::Ptr &sock);
+
     /**
      * 获取上次socket发送缓存清空至今的毫秒数,单位毫秒
      */
@@ -455,19 +557,72 @@ private:
     void onFlushed(const SockFD::Ptr &pSock);
     void startWriteAbleEvent(const SockFD::Ptr &sock);
     void stopWriteAbleEvent(const SockFD::Ptr &sock);
+    void updateEvent(const SockFD::Ptr &sock);
     bool listen(const SockFD::Ptr &sock);
     bool flushData(const SockFD::Ptr &sock, bool poller_thread);
+    bool sendDirect(const SockFD::Ptr &sock, BufferSock::Ptr buf);
+    ssize_t send_l(const SockFD::Ptr &sock, BufferSock::Ptr buf, bool try_flush);
+    bool coalesceSend(size_t size);
+    void addSendBytes(size_t n);
+    void subSendBytes(size_t n);
+    void resetSendBuffer();
+    void notifyWatermark();
+    void onWatermarkChanged();
+    void applyBackpressure(bool pause);
+    void flushCoalesced();
     bool attachEvent(const SockFD::Ptr &sock, bool is_udp = false);
+    void attachZeroCopy(const SockFD::Ptr &sock);
+    bool onErrQueue(const SockFD::Ptr &sock);
+    void releaseZeroCopy();
 
 private:
+    //未启用互斥锁，该socket只在poller线程中访问
+    bool _poller_only;
     //send socket时的flag
     int _sock_flags = SOCKET_DEFAULE_FLAGS;
+    //是否开启udp gso
+    atomic<bool> _enable_udp_gso {false};
+    //是否开启tcp零拷贝发送
+    bool _enable_zerocopy = false;
+    //零拷贝发送数据字节数阈值，只在poller线程中访问
+    size_t _zerocopy_threshold = 0;
+    //零拷贝发送后等待内核通知完成的数据包，只在poller线程中访问
+    ZeroCopyQueue::Ptr _zerocopy;
+    //零拷贝列队所属的fd，替换fd后需要保持其打开直到原列队中的发送全部完成
+    SockNum::Ptr _zerocopy_num;
+    //是否使用循环池中的独享接收缓存
+    bool _enable_recv_pool = false;
+    //是否合并发送，只在poller线程中修改
+    atomic<bool> _send_coalesce {false};
+    //合并发送的字节数阈值，只在poller线程中访问
+    size_t _coalesce_max_bytes = 0;
+    //本轮poller循环中已合并的字节数，只在poller线程中访问
+    size_t _coalesce_bytes = 0;
+    //是否已经添加了循环结束时的发送任务，只在poller线程中访问
+    bool _coalesce_pending = false;
     //最大发送缓存，单位毫秒，距上次发送缓存清空时间不能超过该参数
     uint32_t _max_send_buffer_ms = SEND_TIME_OUT_SEC * 1000;
     //控制是否接收监听socket可读事件，关闭后可用于流量控制
     atomic<bool> _enable_recv {true};
     //标记该socket是否可写，socket写缓存满了就不可写
     atomic<bool> _sendable {true};
+    //是否一直监听可写事件
+    atomic<bool> _edge_write {false};
+    //发送缓存字节数
+    atomic<size_t> _send_buf_bytes {0};
+    //连接断开后发送缓存被清空的次数，用于判断跨线程转交中的数据是否已随之清零
+    atomic<uint32_t> _send_buf_epoch {0};
+    //_sock_fd被赋值为新连接的次数，用于判断跨线程转交期间是否已重连
+    atomic<uint32_t> _sock_fd_serial {0};
+    //发送缓存高低水位，高水位为0时不检查；可在任意线程设置，在发送数据的线程读取
+    atomic<size_t> _high_watermark {0};
+    atomic<size_t> _low_watermark {0};
+    //发送缓存是否处于高水位
+    atomic<bool> _above_watermark {false};
+    //最近一次通知的水位状态，只在poller线程中访问
+    bool _watermark_notified = false;
+    //被关联的socket背压暂停接收的次数，不为0时暂停接收，与_enable_recv相互独立，只在poller线程中访问
+    size_t _backpressure_count = 0;
 
     //tcp连接超时定时器
     Timer::Ptr _con_timer;
@@ -477,7 +632,7 @@ private:
     //记录上次发送缓存(包括socket写缓存、应用层缓存)清空的计时器
     Ticker _send_flush_ticker;
     //复用的socket读缓存，每次read socket后，数据存放在此
-    BufferRaw::Ptr _read_buffer;
+    SocketRecvBuffer::Ptr _read_buffer;
     //socket fd的抽象类
     SockFD::Ptr _sock_fd;
     //本socket绑定的poller线程，事件触发于此线程
@@ -491,6 +646,10 @@ private:
     onReadCB _on_read;
     //socket缓存清空事件(可用于发送流速控制)
     onFlush _on_flush;
+    //发送缓存水位变化事件
+    onWatermark _on_watermark;
+    //发送缓存达到高水位时需要暂停接收的socket，以及本socket是否已暂停其接收
+    vector<pair<weak_ptr<Socket>, bool> > _backpressure_socks;
     //tcp监听收到accept请求事件
     onAcceptCB _on_accept;
     //tcp监听收到accept请求，自定义创建peer Socket事件(可以控制子Socket绑定到其他poller线程)
@@ -561,6 +720,13 @@ public:
      */
     void setSendFlags(int flags);
 
+    /**
+     * 设置是否合并发送，同一轮poller循环中发送的数据合并后一次写socket
+     * @param enable 是否开启
+     * @param max_bytes 累积字节数阈值，达到后立即写socket
+     */
+    void setSendCoalesce(bool enable, size_t max_bytes = 64 * 1024);
+
     /**
      * 套接字是否忙，如果套接字写缓存已满则返回true
      */
@@ -15,5 +15,23 @@ namespace toolkit {
 INSTANCE_IMP(SessionMap);
 StatisticImp(TcpServer);
 
+void TcpServer::setReusePort(bool enable, bool cpu_steering) {
+    _reuse_port = enable;
+    _cpu_steering = cpu_steering;
+}
+
+void TcpServer::steerReusePort(int fd, const vector<EventPoller::Ptr> &pollers) {
+    if (!_cpu_steering || pollers.size() < 2) {
+        return;
+    }
+    vector<int> cpus;
+    for (auto &poller : pollers) {
+        cpus.emplace_back(poller->getCpu());
+    }
+    if (SockUtil::setReusePortCpu(fd, cpus) == -1) {
+        WarnL << "按cpu分发连接失败:" << get_uv_errmsg(true);
+    }
+}
+
 } /* namespace toolkit */
 
@@ -14,6 +14,8 @@
 #include <assert.h>
 #include <mutex>
 #include <memory>
+#include <vector>
+#include <algorithm>
 #include <exception>
 #include <functional>
 #include <unordered_map>
@@ -42,6 +44,7 @@ public:
      * 这些子TcpServer对象通过Socket对象克隆的方式在多个poller线程中监听同一个listen fd
      * 这样这个TCP服务器将会通过抢占式accept的方式把客户端均匀的分布到不同的poller线程
      * 通过该方式能实现客户端负载均衡以及提高连接接收速度
+     * 调用setReusePort开启后，子TcpServer对象改为各自绑定一个SO_REUSEPORT socket，由内核分发连接
      */
     TcpServer(const EventPoller::Ptr &poller = nullptr) : Server(poller) {
         setOnCreateSocket(nullptr);
@@ -65,6 +68,9 @@ public:
     template <typename SessionType>
     void start(uint16_t port, const std::string &host = "0.0.0.0", uint32_t backlog = 1024) {
         start_l<SessionType>(port, host, backlog);
+        //按绑定顺序记录SO_REUSEPORT复用组内的各socket及其所在的poller，与内核中的顺序一致
+        _reuse_pollers.assign(1, _poller);
+        _reuse_socks.assign(1, _socket);
         EventPollerPool::Instance().for_each([&](const TaskExecutor::Ptr &executor) {
             EventPoller::Ptr poller = dynamic_pointer_cast<EventPoller>(executor);
             if (poller == _poller || !poller) {
@@ -74,12 +80,38 @@ public:
             if (!serverRef) {
                 serverRef = onCreatServer(poller);
             }
-            if (serverRef) {
+            if (!serverRef) {
+                return;
+            }
+            if (!_reuse_port) {
                 serverRef->cloneFrom(*this);
+                return;
             }
+            try {
+                serverRef->cloneFrom(*this);
+            } catch (std::exception &ex) {
+                //监听失败的socket不在复用组内，该poller不再接收连接
+                WarnL << "poller线程独立监听失败:" << ex.what();
+                _cloned_server.erase(poller.get());
+                return;
+            }
+            _reuse_pollers.emplace_back(poller);
+            _reuse_socks.emplace_back(serverRef->_socket);
         });
+        if (_reuse_port) {
+            watchReusePort();
+            steerReusePort(_socket->rawFD(), _reuse_pollers);
+        }
     }
 
+    /**
+     * 设置多线程监听方式，须在start前调用
+     * 开启后每个poller线程各自绑定一个SO_REUSEPORT socket，由内核分发连接，避免多线程抢占同一个listen fd
+     * @param enable 是否每个poller线程使用独立的监听socket
+     * @param cpu_steering 是否按处理数据包的cpu选择对应poller线程(需EventPollerPool开启cpu亲和性)，仅linux有效
+     */
+    void setReusePort(bool enable, bool cpu_steering = false);
+
     /**
      * 获取服务器监听端口号，服务器可以选择监听随机端口
      */
@@ -119,7 +151,20 @@ protected:
         }
         _on_create_socket = that._on_create_socket;
         _session_alloc = that._session_alloc;
-        _socket->cloneFromListenSocket(*(that._socket));
+        _reuse_port = that._reuse_port;
+        _cpu_steering = that._cpu_steering;
+        _backlog = that._backlog;
+        if (_reuse_port) {
+            //本线程独立绑定一个SO_REUSEPORT socket
+            auto port = that._socket->get_local_port();
+            auto host = that._socket->get_local_ip();
+            if (!_socket->listen(port, host, _backlog)) {
+                string err = (StrPrinter << "listen on " << host << ":" << port << " failed:" << get_uv_errmsg(true));
+                throw std::runtime_error(err);
+            }
+        } else {
+            _socket->cloneFromListenSocket(*(that._socket));
+        }
         weak_ptr<TcpServer> weak_self = std::dynamic_pointer_cast<TcpServer>(shared_from_this());
         _timer = std::make_shared<Timer>(2.0f, [weak_self]() -> bool {
             auto strong_self = weak_self.lock();
@@ -213,6 +258,7 @@ private:
             return std::make_shared<SessionHelper>(server, session);
         };
 
+        _backlog = backlog;
         if (!_socket->listen(port, host.c_str(), backlog)) {
             //创建tcp监听失败，可能是由于端口占用或权限问题
             string err = (StrPrinter << "listen on " << host << ":" << port << " failed:" << get_uv_errmsg(true));
@@ -256,15 +302,77 @@ private:
         return _on_create_socket(_poller);
     }
 
+    /**
+     * 为SO_REUSEPORT端口复用组挂载按cpu分发的程序，复用组变化后需要重新挂载
+     * @param fd 复用组内任意socket
+     * @param pollers 复用组内各socket(按内核中的顺序)所在的poller线程
+     */
+    void steerReusePort(int fd, const vector<EventPoller::Ptr> &pollers);
+
+    //监听复用组内各socket的异常关闭(比如accept时文件描述符耗尽)
+    void watchReusePort() {
+        weak_ptr<TcpServer> weak_self = std::dynamic_pointer_cast<TcpServer>(shared_from_this());
+        for (auto &weak_sock : _reuse_socks) {
+            auto sock = weak_sock.lock();
+            if (!sock) {
+                continue;
+            }
+            //保留使用者设置的异常回调，在其之后追加处理
+            auto on_err = sock->getOnErr();
+            sock->setOnErr([weak_self, weak_sock, on_err](const SockException &err) {
+                on_err(err);
+                auto strong_self = weak_self.lock();
+                if (!strong_self) {
+                    return;
+                }
+                //复用组由主server管理，切换至其poller线程
+                strong_self->_poller->async([weak_self, weak_sock, err]() {
+                    if (auto strong_self = weak_self.lock()) {
+                        strong_self->onReusePortClosed(weak_sock, err);
+                    }
+                }, false);
+            });
+        }
+    }
+
+    void onReusePortClosed(const weak_ptr<Socket> &sock, const SockException &err) {
+        assert(_poller->isCurrentThread());
+        //socket可能已经销毁，按控制块比较
+        auto it = std::find_if(_reuse_socks.begin(), _reuse_socks.end(), [&](const weak_ptr<Socket> &item) {
+            return !item.owner_before(sock) && !sock.owner_before(item);
+        });
+        if (it == _reuse_socks.end()) {
+            return;
+        }
+        //内核从复用组移除socket时，把组内最后一个socket移至其位置，此处保持相同的顺序
+        auto index = it - _reuse_socks.begin();
+        _reuse_socks[index] = _reuse_socks.back();
+        _reuse_socks.pop_back();
+        _reuse_pollers[index] = _reuse_pollers.back();
+        _reuse_pollers.pop_back();
+        WarnL << "SO_REUSEPORT复用组内的监听socket被关闭:" << err.what() << ", 剩余监听socket个数:" << _reuse_socks.size();
+        auto front = _reuse_socks.empty() ? nullptr : _reuse_socks.front().lock();
+        if (front) {
+            //复用组变化后按新的顺序重新挂载分发程序
+            steerReusePort(front->rawFD(), _reuse_pollers);
+        }
+    }
+
 private:
     bool _cloned = false;
     bool _is_on_manager = false;
+    bool _reuse_port = false;
+    bool _cpu_steering = false;
+    uint32_t _backlog = 1024;
     Socket::Ptr _socket;
     std::shared_ptr<Timer> _timer;
     Socket::onCreateSocket _on_create_socket;
     unordered_map<SessionHelper *, SessionHelper::Ptr> _session_map;
     function<SessionHelper::Ptr(const TcpServer::Ptr &server, const Socket::Ptr &)> _session_alloc;
     unordered_map<EventPoller *, Ptr> _cloned_server;
+    //SO_REUSEPORT复用组内的各socket及其所在的poller，按内核中的顺序排列，仅主server有效
+    vector<weak_ptr<Socket> > _reuse_socks;
+    vector<EventPoller::Ptr> _reuse_pollers;
     //对象个数统计
     ObjectStatistic<TcpServer> _statistic;
 };
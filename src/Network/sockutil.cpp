@@ -22,6 +22,9 @@
 #if defined (__APPLE__)
 #include <ifaddrs.h>
 #endif
+#if defined(__linux__)
+#include <linux/filter.h>
+#endif
 using namespace std;
 
 namespace toolkit {
@@ -63,6 +66,19 @@ int SockUtil::setCloseWait(int sockFd, int second) {
     }
     return ret;
 }
+int SockUtil::setZeroCopy(int sockFd, bool on) {
+#if defined(SO_ZEROCOPY)
+    int opt = on ? 1 : 0;
+    int ret = setsockopt(sockFd, SOL_SOCKET, SO_ZEROCOPY, (char *) &opt, static_cast<socklen_t>(sizeof(opt)));
+    if (ret == -1) {
+        TraceL << "设置 SO_ZEROCOPY 失败!";
+    }
+    return ret;
+#else
+    return -1;
+#endif
+}
+
 int SockUtil::setNoDelay(int sockFd, bool on) {
     int opt = on ? 1 : 0;
     int ret = setsockopt(sockFd, IPPROTO_TCP, TCP_NODELAY,(char *)&opt,static_cast<socklen_t>(sizeof(opt)));
@@ -88,6 +104,51 @@ int SockUtil::setReuseable(int sockFd, bool on) {
     return ret;
 }
 
+int SockUtil::setReusePortCpu(int sockFd, const vector<int> &cpus) {
+#if defined(SO_ATTACH_REUSEPORT_CBPF) && defined(SKF_AD_CPU)
+    if (cpus.empty()) {
+        return -1;
+    }
+    vector<struct sock_filter> code;
+    //A = 当前处理该数据包的cpu
+    code.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, (uint32_t)(SKF_AD_OFF + SKF_AD_CPU)));
+    for (size_t i = 0; i < cpus.size(); ++i) {
+        if (cpus[i] < 0) {
+            continue;
+        }
+        //if (A == cpu) return i;
+        code.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (uint32_t)cpus[i], 0, 1));
+        code.push_back(BPF_STMT(BPF_RET | BPF_K, (uint32_t)i));
+    }
+    //return A % size;
+    code.push_back(BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, (uint32_t)cpus.size()));
+    code.push_back(BPF_STMT(BPF_RET | BPF_A, 0));
+
+    struct sock_fprog prog;
+    prog.len = (unsigned short)code.size();
+    prog.filter = code.data();
+    int ret = setsockopt(sockFd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, static_cast<socklen_t>(sizeof(prog)));
+    if (ret == -1) {
+        TraceL << "设置 SO_ATTACH_REUSEPORT_CBPF 失败!";
+    }
+    return ret;
+#else
+    return -1;
+#endif
+}
+
+int SockUtil::setBusyPoll(int sockFd, int usec) {
+#if defined(SO_BUSY_POLL)
+    int ret = setsockopt(sockFd, SOL_SOCKET, SO_BUSY_POLL, (char *) &usec, static_cast<socklen_t>(sizeof(usec)));
+    if (ret == -1) {
+        TraceL << "设置 SO_BUSY_POLL 失败!";
+    }
+    return ret;
+#else
+    return -1;
+#endif
+}
+
 int SockUtil::setBroadcast(int sockFd, bool on) {
     int opt = on ? 1 : 0;
     int ret = setsockopt(sockFd, SOL_SOCKET, SO_BROADCAST, (char *)&opt,static_cast<socklen_t>(sizeof(opt)));
@@ -305,6 +366,13 @@ int SockUtil::listen(const uint16_t port, const char* localIp, int backLog) {
     setReuseable(sockfd);
     setNoBlocked(sockfd);
     setCloExec(sockfd);
+#if defined(__linux__)
+    //linux下accept出的socket继承监听socket的以下选项，免去每个连接单独设置的系统调用
+    setNoDelay(sockfd);
+    setSendBuf(sockfd);
+    setRecvBuf(sockfd);
+    setCloseWait(sockfd);
+#endif
 
     if(bindSock(sockfd,localIp,port) == -1){
         close(sockfd);
@@ -154,6 +154,24 @@ public:
      */
     static int setReuseable(int sock, bool on = true);
 
+    /**
+     * 为SO_REUSEPORT端口复用组挂载cBPF程序，使新连接(或udp数据包)分发到当前cpu对应的socket
+     * 仅linux支持，其他平台直接返回-1
+     * @param sock 复用组内任意socket fd号
+     * @param cpus 复用组内各socket(按绑定顺序)对应的cpu核心，未匹配的cpu按取模分发
+     * @return 0代表成功，-1为失败
+     */
+    static int setReusePortCpu(int sock, const vector<int> &cpus);
+
+    /**
+     * 设置socket忙轮询(SO_BUSY_POLL)，读取数据时在网卡驱动层忙等待，仅linux支持
+     * 超过net.core.busy_read的值时需要CAP_NET_ADMIN权限
+     * @param sock socket fd号
+     * @param usec 忙轮询时长，单位微秒
+     * @return 0代表成功，-1为失败
+     */
+    static int setBusyPoll(int sock, int usec);
+
     /**
      * 运行发送或接收udp广播信息
      * @param sock socket fd号
@@ -186,6 +204,14 @@ public:
      */
     static int setCloseWait(int sock, int second = 0);
 
+    /**
+     * 开启SO_ZEROCOPY特性，之后才能使用MSG_ZEROCOPY发送数据，仅linux 4.14以上支持
+     * @param sock socket fd号
+     * @param on 是否开启
+     * @return 0代表成功，-1为失败
+     */
+    static int setZeroCopy(int sock, bool on = true);
+
     /**
      * dns解析
      * @param host 域名或ip
@@ -11,6 +11,12 @@
 #include <fcntl.h>
 #include <string.h>
 #include <list>
+#include <map>
+#include <chrono>
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
 #include "SelectWrap.h"
 #include "EventPoller.h"
 #include "Util/util.h"
@@ -22,6 +28,11 @@
 #include "Network/sockutil.h"
 
 
+#if defined(HAS_EVENTFD)
+    #include <unistd.h>
+    #include <sys/eventfd.h>
+#endif //HAS_EVENTFD
+
 #if defined(HAS_EPOLL)
     #include <sys/epoll.h>
 
@@ -30,14 +41,20 @@
     #endif
 
     #define EPOLL_SIZE 1024
+    #define toEpollData(fd, generation) (((uint64_t) (generation) << 32) | (uint32_t) (fd))
     #define toEpoll(event)    (((event) & Event_Read) ? EPOLLIN : 0) \
                                 | (((event) & Event_Write) ? EPOLLOUT : 0) \
                                 | (((event) & Event_Error) ? (EPOLLHUP | EPOLLERR) : 0) \
-                                | (((event) & Event_LT) ?  0 : EPOLLET)
+                                | (((event) & Event_LT) ?  0 : EPOLLET) \
+                                | (((event) & Event_Exclusive) ? EPOLLEXCLUSIVE : 0)
     #define toPoller(epoll_event) (((epoll_event) & EPOLLIN) ? Event_Read : 0) \
                                 | (((epoll_event) & EPOLLOUT) ? Event_Write : 0) \
                                 | (((epoll_event) & EPOLLHUP) ? Event_Error : 0) \
                                 | (((epoll_event) & EPOLLERR) ? Event_Error : 0)
+
+    //监听记录表每块的记录个数与最多的块数，最多可以监听fd小于4M的文件描述符
+    static constexpr size_t kEventChunkSize = 1024;
+    static constexpr size_t kEventChunkCount = 4096;
 #endif //HAS_EPOLL
 
 namespace toolkit {
@@ -46,10 +63,17 @@ EventPoller &EventPoller::Instance() {
     return *(EventPollerPool::Instance().getFirstPoller());
 }
 
-EventPoller::EventPoller(ThreadPool::Priority priority ) {
+EventPoller::EventPoller(ThreadPool::Priority priority) {
     _priority = priority;
+#if defined(HAS_EVENTFD)
+    _event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_event_fd == -1) {
+        throw runtime_error(StrPrinter << "创建eventfd失败:" << get_uv_errmsg());
+    }
+#else
     SockUtil::setNoBlocked(_pipe.readFD());
     SockUtil::setNoBlocked(_pipe.writeFD());
+#endif //HAS_EVENTFD
 
 #if defined(HAS_EPOLL)
     _epoll_fd = epoll_create(EPOLL_SIZE);
@@ -57,12 +81,21 @@ EventPoller::EventPoller(ThreadPool::Priority priority ) {
         throw runtime_error(StrPrinter << "创建epoll文件描述符失败:" << get_uv_errmsg());
     }
     SockUtil::setCloExec(_epoll_fd);
+    _event_map.reset(new atomic<Epoll_Record *>[kEventChunkCount]);
+    for (size_t i = 0; i < kEventChunkCount; ++i) {
+        _event_map[i] = nullptr;
+    }
 #endif //HAS_EPOLL
     _logger = Logger::Instance().shared_from_this();
     _loop_thread_id = this_thread::get_id();
 
     //添加内部管道事件
-    if (addEvent(_pipe.readFD(), Event_Read, [this](int event) { onPipeEvent(); }) == -1) {
+#if defined(HAS_EVENTFD)
+    auto wakeup_fd = _event_fd;
+#else
+    auto wakeup_fd = _pipe.readFD();
+#endif //HAS_EVENTFD
+    if (addEvent(wakeup_fd, Event_Read, [this](int event) { onPipeEvent(); }) == -1) {
         throw std::runtime_error("epoll添加管道失败");
     }
 }
@@ -92,9 +125,40 @@ EventPoller::~EventPoller() {
     //退出前清理管道中的数据
     _loop_thread_id = this_thread::get_id();
     onPipeEvent();
+#if defined(HAS_EVENTFD)
+    close(_event_fd);
+    _event_fd = -1;
+#endif //HAS_EVENTFD
+#if defined(HAS_EPOLL)
+    for (size_t i = 0; i < kEventChunkCount; ++i) {
+        //先置空再释放，防止析构回调对象时再次访问该块
+        delete[] _event_map[i].exchange(nullptr);
+    }
+#endif //HAS_EPOLL
     InfoL << this;
 }
 
+#if defined(HAS_EPOLL)
+EventPoller::Epoll_Record *EventPoller::getRecord(int fd) const {
+    if (fd < 0 || (size_t) fd >= kEventChunkSize * kEventChunkCount) {
+        return nullptr;
+    }
+    auto chunk = _event_map[fd / kEventChunkSize].load(memory_order_acquire);
+    return chunk ? &chunk[fd % kEventChunkSize] : nullptr;
+}
+
+EventPoller::Epoll_Record *EventPoller::obtainRecord(int fd) {
+    if (fd < 0 || (size_t) fd >= kEventChunkSize * kEventChunkCount) {
+        return nullptr;
+    }
+    auto &chunk = _event_map[fd / kEventChunkSize];
+    if (!chunk.load(memory_order_relaxed)) {
+        chunk.store(new Epoll_Record[kEventChunkSize], memory_order_release);
+    }
+    return &chunk.load(memory_order_relaxed)[fd % kEventChunkSize];
+}
+#endif //HAS_EPOLL
+
 int EventPoller::addEvent(int fd, int event, PollEventCB cb) {
     TimeTicker();
     if (!cb) {
@@ -104,12 +168,20 @@ int EventPoller::addEvent(int fd, int event, PollEventCB cb) {
 
     if (isCurrentThread()) {
 #if defined(HAS_EPOLL)
+        auto record = obtainRecord(fd);
+        if (!record) {
+            WarnL << "超出epoll监听记录表范围:" << fd;
+            return -1;
+        }
+        auto generation = record->generation.load(memory_order_relaxed) + 1;
         struct epoll_event ev = {0};
-        ev.events = (toEpoll(event)) | EPOLLEXCLUSIVE;
-        ev.data.fd = fd;
+        ev.events = toEpoll(event);
+        ev.data.u64 = toEpollData(fd, generation);
         int ret = epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &ev);
         if (ret == 0) {
-            _event_map.emplace(fd, std::make_shared<PollEventCB>(std::move(cb)));
+            record->callBack = std::move(cb);
+            record->generation.store(generation, memory_order_release);
+            record->used.store(true, memory_order_release);
         }
         return ret;
 #else
@@ -142,7 +214,13 @@ int EventPoller::delEvent(int fd, PollDelCB cb) {
 
     if (isCurrentThread()) {
 #if defined(HAS_EPOLL)
-        bool success = epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, fd, NULL) == 0 && _event_map.erase(fd) > 0;
+        auto record = getRecord(fd);
+        bool success = epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, fd, NULL) == 0 && record && record->used.load(memory_order_relaxed);
+        if (success) {
+            //如果正在执行该fd的回调，回调对象已被移出，执行完毕后自动释放
+            record->used.store(false, memory_order_release);
+            record->callBack = nullptr;
+        }
         cb(success);
         return success ? 0 : -1;
 #else
@@ -162,10 +240,29 @@ int EventPoller::delEvent(int fd, PollDelCB cb) {
 int EventPoller::modifyEvent(int fd, int event) {
     TimeTicker();
 #if defined(HAS_EPOLL)
-    struct epoll_event ev = {0};
-    ev.events = toEpoll(event);
-    ev.data.fd = fd;
-    return epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+    auto record = getRecord(fd);
+    if (!record || !record->used.load(memory_order_acquire)) {
+        return -1;
+    }
+    auto generation = record->generation.load(memory_order_acquire);
+    auto modify = [this, fd, event, record, generation]() {
+        if (!record->used.load(memory_order_relaxed) || record->generation.load(memory_order_relaxed) != generation) {
+            //该fd已被删除或重新添加，不能修改其他对象的监听
+            return -1;
+        }
+        struct epoll_event ev = {0};
+        ev.events = toEpoll(event);
+        ev.data.u64 = toEpollData(fd, generation);
+        return epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+    };
+    if (isCurrentThread()) {
+        return modify();
+    }
+    //记录表的块分配后不再移动，记录指针在poller线程中依然有效
+    async([modify]() {
+        modify();
+    });
+    return 0;
 #else
     if (isCurrentThread()) {
         auto it = _event_map.find(fd);
@@ -197,25 +294,59 @@ Task::Ptr EventPoller::async_l(TaskIn task,bool may_sync, bool first) {
     }
 
     auto ret = std::make_shared<Task>(std::move(task));
-    {
-        lock_guard<mutex> lck(_mtx_task);
-        if (first) {
-            _list_task.emplace_front(ret);
-        } else {
-            _list_task.emplace_back(ret);
-        }
-    }
-    //写数据到管道,唤醒主线程
-    _pipe.write("", 1);
+    post_l(TaskNode::create([ret]() { (*ret)(); }), first);
     return ret;
 }
 
+void EventPoller::postNode(TaskNode *node, bool may_sync) {
+    if (may_sync && isCurrentThread()) {
+        std::unique_ptr<TaskNode, void (*)(TaskNode *)> holder(node, TaskNode::recycle);
+        holder->run();
+        return;
+    }
+    post_l(node, false);
+}
+
+void EventPoller::post_l(TaskNode *node, bool first) {
+    _task_count.fetch_add(1, memory_order_relaxed);
+    if (first) {
+        _list_task_first.push(node);
+    } else {
+        _list_task.push(node);
+    }
+    //只有事件循环处理任务之后的第一次入列才需要写管道唤醒主线程
+    if (!_wakeup_pending.exchange(true)) {
+        wakeup();
+    }
+}
+
 bool EventPoller::isCurrentThread() {
     return _loop_thread_id == this_thread::get_id();
 }
 
+void EventPoller::wakeup() {
+#if defined(HAS_EVENTFD)
+    uint64_t one = 1;
+    int ret;
+    do {
+        ret = ::write(_event_fd, &one, sizeof(one));
+    } while (-1 == ret && UV_EINTR == get_uv_error(true));
+#else
+    //写数据到管道,唤醒主线程
+    _pipe.write("", 1);
+#endif //HAS_EVENTFD
+}
+
 inline void EventPoller::onPipeEvent() {
     TimeTicker();
+#if defined(HAS_EVENTFD)
+    //一次读取即可清零计数器
+    uint64_t count;
+    int ret;
+    do {
+        ret = ::read(_event_fd, &count, sizeof(count));
+    } while (-1 == ret && UV_EINTR == get_uv_error(true));
+#else
     char buf[1024];
     int err = 0;
     do {
@@ -224,22 +355,31 @@ inline void EventPoller::onPipeEvent() {
         }
         err = get_uv_error(true);
     } while (err != UV_EAGAIN);
+#endif //HAS_EVENTFD
 
-    decltype(_list_task) _list_swap;
-    {
-        lock_guard<mutex> lck(_mtx_task);
-        _list_swap.swap(_list_task);
-    }
+    //先复位唤醒标记再消费任务，此后入列的任务会重新写管道唤醒
+    _wakeup_pending.store(false);
 
-    _list_swap.for_each([&](const Task::Ptr &task) {
+    auto run_task = [&](TaskNode &task) {
         try {
-            (*task)();
+            task.run();
         } catch (ExitException &) {
             _exit_flag = true;
         } catch (std::exception &ex) {
             ErrorL << "EventPoller执行异步任务捕获到异常:" << ex.what();
         }
-    });
+    };
+
+    //async_first的任务后入列的先执行
+    auto task_count = _list_task_first.consume(run_task);
+    task_count += _list_task.consume(run_task);
+    if (task_count) {
+        _task_count.fetch_sub(task_count, memory_order_relaxed);
+    }
+}
+
+size_t EventPoller::taskCount() {
+    return _task_count.load(memory_order_relaxed);
 }
 
 void EventPoller::wait() {
@@ -249,13 +389,12 @@ void EventPoller::wait() {
 static mutex s_all_poller_mtx;
 static map<thread::id, weak_ptr<EventPoller> > s_all_poller;
 
-BufferRaw::Ptr EventPoller::getSharedBuffer() {
-    auto ret = _shared_buffer.lock();
+SocketRecvBuffer::Ptr EventPoller::getSharedBuffer(bool is_udp) {
+    auto &weak_buffer = _shared_buffer[is_udp];
+    auto ret = weak_buffer.lock();
     if (!ret) {
-        //预留一个字节存放\0结尾符
-        ret = BufferRaw::create();
-        ret->setCapacity(1 + SOCKET_DEFAULT_BUF_SIZE);
-        _shared_buffer = ret;
+        ret = SocketRecvBuffer::create(is_udp);
+        weak_buffer = ret;
     }
     return ret;
 }
@@ -270,9 +409,53 @@ EventPoller::Ptr EventPoller::getCurrentPoller(){
     return it->second.lock();
 }
 
+bool EventPoller::isEdgeTriggered() const {
+#if defined(HAS_EPOLL)
+    return true;
+#else
+    return false;
+#endif //HAS_EPOLL
+}
+
+void EventPoller::setBusyPoll(uint32_t spin_us, uint32_t socket_busy_poll_us) {
+    _busy_poll_us = spin_us;
+    _socket_busy_poll_us = socket_busy_poll_us;
+}
+
+uint32_t EventPoller::getSocketBusyPoll() const {
+    return _socket_busy_poll_us;
+}
+
+int EventPoller::getCpu() const {
+    return _cpu;
+}
+
+void EventPoller::bindCpu() {
+    if (!setThreadAffinity(_cpu)) {
+        WarnL << "EventPoller绑定cpu核心失败:" << _cpu;
+        return;
+    }
+    if (!_numa_local) {
+        return;
+    }
+#if defined(__linux__) && defined(SYS_set_mempolicy)
+    //本线程的内存优先在当前numa节点分配(MPOL_LOCAL)，不受进程级交错分配策略影响
+    static constexpr int kMpolLocal = 4;
+    if (syscall(SYS_set_mempolicy, kMpolLocal, nullptr, 0) == -1) {
+        WarnL << "设置numa内存策略失败:" << get_uv_errmsg();
+    }
+#endif
+    //在本线程分配共享读缓存并一直持有，保证其内存位于本节点
+    _local_buffer[0] = getSharedBuffer(false);
+    _local_buffer[1] = getSharedBuffer(true);
+}
+
 void EventPoller::runLoop(bool blocked,bool regist_self) {
     if (blocked) {
         ThreadPool::setPriority(_priority);
+        if (_cpu >= 0) {
+            bindCpu();
+        }
         lock_guard<mutex> lck(_mtx_runing);
         _loop_thread_id = this_thread::get_id();
         if (regist_self) {
@@ -285,9 +468,34 @@ void EventPoller::runLoop(bool blocked,bool regist_self) {
 #if defined(HAS_EPOLL)
         struct epoll_event events[EPOLL_SIZE];
         while (!_exit_flag) {
+            //循环结束任务中可能添加定时器，所以先执行循环结束任务再计算休眠时间
+            flushLoopEndTask();
             minDelay = getMinDelay();
-            startSleep();//用于统计当前线程负载情况
-            int ret = epoll_wait(_epoll_fd, events, EPOLL_SIZE, minDelay ? minDelay : -1);
+            //定时器或循环结束任务中又添加了循环结束任务，那么本轮不能阻塞等待
+            bool no_wait = !_loop_end_task.empty();
+            int ret = 0;
+            auto spin_us = no_wait ? 0 : (uint64_t) _busy_poll_us.load(memory_order_relaxed);
+            if (spin_us) {
+                //忙轮询，最长不超过最近一个定时器的到期时间
+                bool timer_due = minDelay && minDelay * 1000 <= spin_us;
+                if (timer_due) {
+                    spin_us = minDelay * 1000;
+                }
+                startSpin();//用于统计当前线程忙轮询情况
+                auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(spin_us);
+                do {
+                    ret = epoll_wait(_epoll_fd, events, EPOLL_SIZE, 0);
+                } while (ret == 0 && std::chrono::steady_clock::now() < deadline);
+                if (ret == 0 && timer_due) {
+                    //定时器已经到期，无需阻塞等待
+                    sleepWakeUp();
+                    continue;
+                }
+            }
+            if (ret == 0) {
+                startSleep();//用于统计当前线程负载情况
+                ret = epoll_wait(_epoll_fd, events, EPOLL_SIZE, no_wait ? 0 : (minDelay ? minDelay : -1));
+            }
             sleepWakeUp();//用于统计当前线程负载情况
             if (ret <= 0) {
                 //超时或被打断
@@ -295,18 +503,27 @@ void EventPoller::runLoop(bool blocked,bool regist_self) {
             }
             for (int i = 0; i < ret; ++i) {
                 struct epoll_event &ev = events[i];
-                int fd = ev.data.fd;
-                auto it = _event_map.find(fd);
-                if (it == _event_map.end()) {
+                int fd = (int) (ev.data.u64 & 0xFFFFFFFF);
+                auto generation = (uint32_t) (ev.data.u64 >> 32);
+                auto record = getRecord(fd);
+                if (!record || !record->used.load(memory_order_relaxed)) {
                     epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, fd, NULL);
                     continue;
                 }
-                auto cb = it->second;
+                if (record->generation.load(memory_order_relaxed) != generation) {
+                    //本批次中该fd已被删除并重新添加，忽略老的事件
+                    continue;
+                }
+                //回调中可能删除本监听，所以先把回调对象移出，执行完毕后再放回
+                auto cb = std::move(record->callBack);
                 try {
-                    (*cb)(toPoller(ev.events));
+                    cb(toPoller(ev.events));
                 } catch (std::exception &ex) {
                     ErrorL << "EventPoller执行事件回调捕获到异常:" << ex.what();
                 }
+                if (record->used.load(memory_order_relaxed) && record->generation.load(memory_order_relaxed) == generation) {
+                    record->callBack = std::move(cb);
+                }
             }
         }
 #else
@@ -315,8 +532,15 @@ void EventPoller::runLoop(bool blocked,bool regist_self) {
         List<Poll_Record::Ptr> callback_list;
         struct timeval tv;
         while (!_exit_flag) {
+            //循环结束任务中可能添加定时器，所以先执行循环结束任务再计算休眠时间
+            flushLoopEndTask();
             //定时器事件中可能操作_event_map
             minDelay = getMinDelay();
+            //定时器或循环结束任务中又添加了循环结束任务，那么本轮不能阻塞等待
+            bool no_wait = !_loop_end_task.empty();
+            if (no_wait) {
+                minDelay = 0;
+            }
             tv.tv_sec = (decltype(tv.tv_sec))(minDelay / 1000);
             tv.tv_usec = 1000 * (minDelay % 1000);
 
@@ -340,7 +564,7 @@ void EventPoller::runLoop(bool blocked,bool regist_self) {
             }
 
             startSleep();//用于统计当前线程负载情况
-            ret = zl_select(max_fd + 1, &set_read, &set_write, &set_err, minDelay ? &tv : NULL);
+            ret = zl_select(max_fd + 1, &set_read, &set_write, &set_err, (minDelay || no_wait) ? &tv : NULL);
             sleepWakeUp();//用于统计当前线程负载情况
 
             if (ret <= 0) {
@@ -381,56 +605,94 @@ void EventPoller::runLoop(bool blocked,bool regist_self) {
     }
 }
 
-uint64_t EventPoller::flushDelayTask(uint64_t now_time) {
-    decltype(_delay_task_map) task_copy;
-    task_copy.swap(_delay_task_map);
+/**
+ * 延时任务，取消时从时间轮中摘除，使其立即释放而不是残留到到期时刻
+ */
+class EventPoller::DelayTaskImp : public DelayTask, public std::enable_shared_from_this<DelayTaskImp> {
+public:
+    typedef std::shared_ptr<DelayTaskImp> Ptr;
+
+    template <typename FUNC>
+    DelayTaskImp(FUNC &&task, const EventPoller::Ptr &poller) : DelayTask(std::forward<FUNC>(task)), _poller(poller) {}
+
+    void cancel() override {
+        DelayTask::cancel();
+        auto poller = _poller.lock();
+        if (!poller) {
+            return;
+        }
+        //时间轮只能在poller线程中访问
+        auto self = shared_from_this();
+        auto poller_ptr = poller.get();
+        poller->async([poller_ptr, self]() {
+            poller_ptr->_delay_task_wheel.cancel(self->_handle);
+        });
+    }
+
+    //在时间轮中的句柄，只在poller线程中访问
+    TimingWheel<Ptr>::Handle _handle;
 
-    for (auto it = task_copy.begin(); it != task_copy.end() && it->first <= now_time; it = task_copy.erase(it)) {
+private:
+    weak_ptr<EventPoller> _poller;
+};
+
+uint64_t EventPoller::flushDelayTask(uint64_t now_time) {
+    _delay_task_wheel.advance(now_time, [&](DelayTaskImp::Ptr &task) {
         //已到期的任务
         try {
-            auto next_delay = (*(it->second))();
-            if (next_delay) {
-                //可重复任务,更新时间截止线
-                _delay_task_map.emplace(next_delay + now_time, std::move(it->second));
+            auto next_delay = (*task)();
+            if (next_delay && *task) {
+                //可重复任务(执行期间未被取消),更新时间截止线
+                auto &handle = task->_handle;
+                handle = _delay_task_wheel.add(next_delay + now_time, std::move(task));
             }
         } catch (std::exception &ex) {
             ErrorL << "EventPoller执行延时任务捕获到异常:" << ex.what();
         }
-    }
-
-    task_copy.insert(_delay_task_map.begin(), _delay_task_map.end());
-    task_copy.swap(_delay_task_map);
+    });
+    //最近一个定时器的执行延时，没有剩余的定时器时返回0
+    return _delay_task_wheel.nextDelay(now_time);
+}
 
-    auto it = _delay_task_map.begin();
-    if (it == _delay_task_map.end()) {
+uint64_t EventPoller::getMinDelay() {
+    if (_delay_task_wheel.empty()) {
         //没有剩余的定时器了
         return 0;
     }
-    //最近一个定时器的执行延时
-    return it->first - now_time;
+    //执行已到期的任务并刷新休眠延时
+    return flushDelayTask(getCurrentMillisecond());
 }
 
-uint64_t EventPoller::getMinDelay() {
-    auto it = _delay_task_map.begin();
-    if (it == _delay_task_map.end()) {
-        //没有剩余的定时器了
-        return 0;
+void EventPoller::runAtLoopEnd(function<void()> task) {
+    _loop_end_task.emplace_back(std::move(task));
+}
+
+void EventPoller::flushLoopEndTask() {
+    if (_loop_end_task.empty()) {
+        return;
     }
-    auto now = getCurrentMillisecond();
-    if (it->first > now) {
-        //所有任务尚未到期
-        return it->first - now;
+    //任务中可能再次添加，新添加的任务在下一轮循环结束时执行
+    decltype(_loop_end_task) tasks;
+    tasks.swap(_loop_end_task);
+    for (auto &task : tasks) {
+        try {
+            task();
+        } catch (std::exception &ex) {
+            ErrorL << "EventPoller执行循环结束任务捕获到异常:" << ex.what();
+        }
     }
-    //执行已到期的任务并刷新休眠延时
-    return flushDelayTask(now);
 }
 
 DelayTask::Ptr EventPoller::doDelayTask(uint64_t delayMS, function<uint64_t()> task) {
-    DelayTask::Ptr ret = std::make_shared<DelayTask>(std::move(task));
+    auto ret = std::make_shared<DelayTaskImp>(std::move(task), shared_from_this());
     auto time_line = getCurrentMillisecond() + delayMS;
     async_first([time_line, ret, this]() {
+        if (!*ret) {
+            //添加前已被取消
+            return;
+        }
         //异步执行的目的是刷新select或epoll的休眠时间
-        _delay_task_map.emplace(time_line, ret);
+        ret->_handle = _delay_task_wheel.add(time_line, ret);
     });
     return ret;
 }
@@ -438,6 +700,7 @@ DelayTask::Ptr EventPoller::doDelayTask(uint64_t delayMS, function<uint64_t()> t
 ///////////////////////////////////////////////
 
 int s_pool_size = 0;
+static EventPollerPool::Affinity s_affinity = EventPollerPool::AFFINITY_NONE;
 
 INSTANCE_IMP(EventPollerPool);
 
@@ -446,29 +709,65 @@ EventPoller::Ptr EventPollerPool::getFirstPoller(){
 }
 
 EventPoller::Ptr EventPollerPool::getPoller(){
-    auto poller = EventPoller::getCurrentPoller();
-    if(_preferCurrentThread && poller){
-        return poller;
+    if (_preferCurrentThread) {
+        auto poller = EventPoller::getCurrentPoller();
+        if (poller) {
+            return poller;
+        }
     }
-    return dynamic_pointer_cast<EventPoller>(getExecutor());
+    return static_pointer_cast<EventPoller>(getExecutor());
 }
 
 void EventPollerPool::preferCurrentThread(bool flag){
     _preferCurrentThread = flag;
 }
 
+/**
+ * 按亲和性策略获取各EventPoller依次绑定的cpu核心
+ */
+static vector<int> getAffinityCpus(EventPollerPool::Affinity affinity) {
+    auto cpus = getAvailableCpus();
+    if (affinity != EventPollerPool::AFFINITY_NUMA) {
+        return cpus;
+    }
+    //按numa节点分组后交错排列，使EventPoller均匀分布在各节点
+    map<int, vector<int> > nodes;
+    for (auto cpu : cpus) {
+        nodes[getCpuNumaNode(cpu)].emplace_back(cpu);
+    }
+    vector<int> ret;
+    for (size_t i = 0; ret.size() < cpus.size(); ++i) {
+        for (auto &pr : nodes) {
+            if (i < pr.second.size()) {
+                ret.emplace_back(pr.second[i]);
+            }
+        }
+    }
+    return ret;
+}
+
 EventPollerPool::EventPollerPool(){
     auto size = s_pool_size > 0 ? s_pool_size : thread::hardware_concurrency();
-    createThreads([]() {
+    vector<int> cpus;
+    if (s_affinity != AFFINITY_NONE) {
+        cpus = getAffinityCpus(s_affinity);
+    }
+    size_t index = 0;
+    createThreads([&]() {
         EventPoller::Ptr ret(new EventPoller);
+        if (!cpus.empty()) {
+            ret->_cpu = cpus[index++ % cpus.size()];
+            ret->_numa_local = s_affinity == AFFINITY_NUMA;
+        }
         ret->runLoop(false, true);
         return ret;
     }, size);
     InfoL << "创建EventPoller个数:" << size;
 }
 
-void EventPollerPool::setPoolSize(int size) {
+void EventPollerPool::setPoolSize(int size, Affinity affinity) {
     s_pool_size = size;
+    s_affinity = affinity;
 }
 
 
@@ -16,11 +16,14 @@
 #include <string>
 #include <functional>
 #include <memory>
+#include <vector>
 #include <unordered_map>
 #include "PipeWrap.h"
+#include "TimingWheel.h"
 #include "Util/logger.h"
 #include "Util/util.h"
 #include "Util/List.h"
+#include "Thread/TaskNode.h"
 #include "Thread/TaskExecutor.h"
 #include "Thread/ThreadPool.h"
 #include "Network/Buffer.h"
@@ -28,6 +31,7 @@ using namespace std;
 
 #if defined(__linux__) || defined(__linux)
 #define HAS_EPOLL
+#define HAS_EVENTFD
 #endif //__linux__
 
 namespace toolkit {
@@ -37,6 +41,7 @@ typedef enum {
     Event_Write = 1 << 1, //写事件
     Event_Error = 1 << 2, //错误事件
     Event_LT = 1 << 3,//水平触发
+    Event_Exclusive = 1 << 4,//独占唤醒，多个poller监听同一fd时每次只唤醒其中一个，仅epoll有效且不可modifyEvent
 } Poll_Event;
 
 typedef function<void(int event)> PollEventCB;
@@ -76,9 +81,12 @@ public:
 
     /**
      * 修改监听事件类型
+     * 在poller线程中调用时同步修改；在其他线程调用时切换至poller线程异步修改，多次修改按调用顺序执行，
+     * 所以需要根据其他线程可能修改的状态计算事件类型时，应在poller线程中计算后再调用本函数
+     * 异步修改只作用于调用时的监听，执行前该fd已被删除或重新添加(比如fd被关闭后复用)则放弃修改
      * @param fd 监听的文件描述符
      * @param event 事件类型，例如 Event_Read | Event_Write
-     * @return -1:失败，0:成功
+     * @return -1:失败(fd未被监听)，0:成功；其他线程调用时修改尚未执行，返回0仅代表调用时该fd处于监听状态
      */
     int modifyEvent(int fd, int event);
 
@@ -98,12 +106,43 @@ public:
      */
     Task::Ptr async_first(TaskIn task, bool may_sync = true) override ;
 
+    /**
+     * 投递任务节点，post方法的实现，任务节点直接进入无锁列队，通常不需要任何内存分配
+     * @param node 任务节点
+     * @param may_sync 如果调用该函数的线程就是本对象的轮询线程，那么may_sync为true时就是同步执行任务
+     */
+    void postNode(TaskNode *node, bool may_sync) override;
+
+    /**
+     * 获取尚未执行的异步任务个数
+     */
+    size_t taskCount() override;
+
     /**
      * 判断执行该接口的线程是否为本对象的轮询线程
      * @return 是否为本对象的轮询线程
      */
     bool isCurrentThread();
 
+    /**
+     * 是否为边沿触发的epoll轮询，select的监听为水平触发
+     */
+    bool isEdgeTriggered() const;
+
+    /**
+     * 设置忙轮询，适用于对延时敏感的poller线程，仅epoll有效
+     * 开启后轮询线程在阻塞等待事件前，先以0超时循环epoll_wait，省去线程休眠唤醒的开销
+     * 忙轮询的时间不计入load()，可通过spinLoad()获取
+     * @param spin_us 每次阻塞等待前的忙轮询时长，单位微秒，0为关闭
+     * @param socket_busy_poll_us 此后加入本线程的socket设置的SO_BUSY_POLL时长，单位微秒，0为不设置
+     */
+    void setBusyPoll(uint32_t spin_us, uint32_t socket_busy_poll_us = 0);
+
+    /**
+     * 获取socket的SO_BUSY_POLL时长，单位微秒，0为不设置
+     */
+    uint32_t getSocketBusyPoll() const;
+
     /**
      * 延时执行某个任务
      * @param delayMS 延时毫秒数
@@ -112,6 +151,13 @@ public:
      */
     DelayTask::Ptr doDelayTask(uint64_t delayMS, function<uint64_t()> task);
 
+    /**
+     * 在本轮事件循环结束、即将等待新的事件前执行任务，只能在poller线程中调用
+     * 用于合并同一轮循环中的多次操作，比如多次发送的数据合并写socket
+     * @param task 任务，只执行一次
+     */
+    void runAtLoopEnd(function<void()> task);
+
     /**
      * 获取当前线程关联的Poller实例
      */
@@ -119,8 +165,15 @@ public:
 
     /**
      * 获取当前线程下所有socket共享的读缓存
+     * @param is_udp 是否为udp socket，udp socket使用批量接收缓存
      */
-    BufferRaw::Ptr getSharedBuffer();
+    SocketRecvBuffer::Ptr getSharedBuffer(bool is_udp = false);
+
+    /**
+     * 获取轮询线程绑定的cpu核心
+     * @return -1代表未绑定
+     */
+    int getCpu() const;
 
 private:
     /**
@@ -135,11 +188,21 @@ private:
      */
     void runLoop(bool blocked , bool regist_self);
 
+    /**
+     * 绑定轮询线程至_cpu核心，并按需在本numa节点预先分配读缓存
+     */
+    void bindCpu();
+
     /**
      * 内部管道事件，用于唤醒轮询线程用
      */
     void onPipeEvent();
 
+    /**
+     * 唤醒轮询线程
+     */
+    void wakeup();
+
     /**
      * 切换线程并执行任务
      * @param task
@@ -149,6 +212,13 @@ private:
      */
     Task::Ptr async_l(TaskIn task, bool may_sync = true,bool first = false) ;
 
+    /**
+     * 任务节点入列并唤醒轮询线程
+     * @param node 任务节点
+     * @param first 是否打入任务列队头
+     */
+    void post_l(TaskNode *node, bool first);
+
     /**
      * 阻塞当前线程，等待轮询线程退出;
      * 在执行shutdown接口时本函数会退出
@@ -171,7 +241,30 @@ private:
      */
     uint64_t getMinDelay();
 
+    /**
+     * 执行本轮事件循环结束时的任务
+     */
+    void flushLoopEndTask();
+
+#if defined(HAS_EPOLL)
+    struct Epoll_Record;
+
+    /**
+     * 获取fd的监听记录，可在任意线程调用
+     * @return 所在的块尚未分配时返回nullptr
+     */
+    Epoll_Record *getRecord(int fd) const;
+
+    /**
+     * 获取fd的监听记录，所在的块尚未分配时分配之，只能在poller线程调用
+     * @return fd超出记录表范围时返回nullptr
+     */
+    Epoll_Record *obtainRecord(int fd);
+#endif //HAS_EPOLL
+
 private:
+    class DelayTaskImp;
+
     class ExitException : public std::exception{
     public:
         ExitException(){}
@@ -181,10 +274,20 @@ private:
 private:
     //标记loop线程是否退出
     bool _exit_flag;
-    //当前线程下，所有socket共享的读缓存
-    weak_ptr<BufferRaw> _shared_buffer;
+    //当前线程下，所有socket共享的读缓存，分别为tcp与udp
+    weak_ptr<SocketRecvBuffer> _shared_buffer[2];
+    //绑定线程时，在本线程预先分配并持有的共享读缓存，保证其内存位于本numa节点
+    SocketRecvBuffer::Ptr _local_buffer[2];
     //线程优先级
     ThreadPool::Priority _priority;
+    //绑定的cpu核心，-1为不绑定
+    int _cpu = -1;
+    //是否在本numa节点分配内存
+    bool _numa_local = false;
+    //忙轮询时长，单位微秒
+    atomic<uint32_t> _busy_poll_us{0};
+    //socket的SO_BUSY_POLL时长，单位微秒
+    atomic<uint32_t> _socket_busy_poll_us{0};
     //正在运行事件循环时该锁处于被锁定状态
     mutex _mtx_runing;
     //执行事件循环的线程
@@ -194,11 +297,21 @@ private:
     //通知事件循环的线程已启动
     semaphore _sem_run_started;
 
+#if defined(HAS_EVENTFD)
+    //内部唤醒事件，多次唤醒合并为一次计数器读取
+    int _event_fd = -1;
+#else
     //内部事件管道
     PipeWrap _pipe;
-    //从其他线程切换过来的任务
-    mutex _mtx_task;
-    List<Task::Ptr> _list_task;
+#endif //HAS_EVENTFD
+    //从其他线程切换过来的任务，侵入式无锁多生产者单消费者列队
+    TaskNodeQueue _list_task;
+    //通过async_first切换过来的任务，后进先出，优先于_list_task执行
+    TaskNodeStack _list_task_first;
+    //是否已经写管道唤醒了事件循环，用于合并唤醒，事件循环处理任务前复位
+    atomic<bool> _wakeup_pending{false};
+    //尚未执行的异步任务个数，用于按列队深度选择poller
+    atomic<size_t> _task_count{0};
 
     //保持日志可用
     Logger::Ptr _logger;
@@ -206,7 +319,16 @@ private:
 #if defined(HAS_EPOLL)
     //epoll相关
     int _epoll_fd = -1;
-    unordered_map<int, std::shared_ptr<PollEventCB> > _event_map;
+    struct Epoll_Record {
+        //每次添加监听时递增，与fd一起保存在epoll_event.data中，用于过滤已删除监听的残留事件
+        //只在poller线程中修改，其他线程调用modifyEvent时读取
+        atomic<uint32_t> generation{0};
+        atomic<bool> used{false};
+        //只在poller线程中访问
+        PollEventCB callBack;
+    };
+    //以fd为下标的监听记录表，按块分配且分配后不再移动，所以其他线程可以安全读取已分配的记录
+    std::unique_ptr<atomic<Epoll_Record *>[]> _event_map;
 #else
     //select相关
     struct Poll_Record {
@@ -219,7 +341,9 @@ private:
 #endif //HAS_EPOLL
 
     //定时器相关
-    multimap<uint64_t, DelayTask::Ptr> _delay_task_map;
+    TimingWheel<std::shared_ptr<DelayTaskImp> > _delay_task_wheel{getCurrentMillisecond()};
+    //本轮事件循环结束时执行的任务，只在poller线程中访问
+    vector<function<void()> > _loop_end_task;
 };
 
 
@@ -234,12 +358,25 @@ public:
      */
     static EventPollerPool &Instance();
 
+    /**
+     * EventPoller线程的cpu亲和性策略
+     */
+    typedef enum {
+        //不绑定cpu核心
+        AFFINITY_NONE = 0,
+        //每个EventPoller线程依次绑定一个cpu核心
+        AFFINITY_CORE,
+        //绑定cpu核心，EventPoller在各numa节点间轮流分布，且读缓存与接收缓存池在本节点分配
+        AFFINITY_NUMA,
+    } Affinity;
+
     /**
      * 设置EventPoller个数，在EventPollerPool单例创建前有效
      * 在不调用此方法的情况下，默认创建thread::hardware_concurrency()个EventPoller实例
      * @param size  EventPoller个数，如果为0则为thread::hardware_concurrency()
+     * @param affinity cpu亲和性策略，EventPoller个数超过可用cpu核心数时循环绑定
      */
-    static void setPoolSize(int size = 0);
+    static void setPoolSize(int size = 0, Affinity affinity = AFFINITY_NONE);
 
     /**
      * 获取第一个实例
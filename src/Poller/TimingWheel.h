@@ -0,0 +1,414 @@
+﻿/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/xia-chu/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLTOOLKIT_TIMINGWHEEL_H
+#define ZLTOOLKIT_TIMINGWHEEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <utility>
+#include <algorithm>
+using namespace std;
+
+namespace toolkit {
+
+/**
+ * 分层时间轮，精度为1毫秒
+ * 第0层256个槽，第1~4层各64个槽，共可表示2^32毫秒(约49天)以内的超时，更长的超时会在到达最高层后重新分配
+ * 添加、取消与到期均为O(1)，每个槽使用位图标记是否为空，可以快速跳过空槽并计算最近的唤醒时间
+ * 槽中的定时器为双向链表，取消时直接从所在的槽中摘除并回收，不会残留到到期时刻
+ * 该对象非线程安全
+ * @tparam T 定时器携带的数据类型，必须可以默认构造
+ */
+template<typename T>
+class TimingWheel {
+private:
+    struct Node;
+
+public:
+    /**
+     * 定时器句柄，用于取消定时器
+     * 定时器到期或被取消后句柄失效，此时再取消不会产生任何影响
+     */
+    class Handle {
+    public:
+        Handle() = default;
+
+    private:
+        friend class TimingWheel;
+        Handle(Node *node, uint64_t seq) : _node(node), _seq(seq) {}
+
+    private:
+        Node *_node = nullptr;
+        uint64_t _seq = 0;
+    };
+
+    /**
+     * @param now_ms 当前时间，单位毫秒
+     */
+    explicit TimingWheel(uint64_t now_ms) {
+        _now = now_ms;
+        for (size_t index = 0; index < kSlots0; ++index) {
+            _slots0[index].bitmap = &_bitmap0[index >> 6];
+            _slots0[index].bit = 1ULL << (index & 63);
+        }
+        for (size_t level = 0; level < kLevels; ++level) {
+            for (size_t index = 0; index < kSlots; ++index) {
+                _slots[level][index].bitmap = &_bitmap[level];
+                _slots[level][index].bit = 1ULL << index;
+            }
+        }
+    }
+
+    ~TimingWheel() {
+        for (auto &slot : _slots0) {
+            freeList(slot.head);
+        }
+        for (auto &level : _slots) {
+            for (auto &slot : level) {
+                freeList(slot.head);
+            }
+        }
+        freeList(_ready.head);
+        freeList(_firing.head);
+        while (_free_nodes) {
+            auto next = _free_nodes->next;
+            delete _free_nodes;
+            _free_nodes = next;
+        }
+    }
+
+    TimingWheel(const TimingWheel &that) = delete;
+    TimingWheel &operator=(const TimingWheel &that) = delete;
+
+    /**
+     * 添加定时器
+     * @param expire_ms 到期时间，单位毫秒，不大于当前时间时在下次advance时立即到期
+     * @param value 定时器携带的数据
+     * @return 定时器句柄，用于取消定时器
+     */
+    Handle add(uint64_t expire_ms, T value) {
+        auto node = allocNode();
+        node->expire = expire_ms;
+        node->value = std::move(value);
+        ++_size;
+        if (expire_ms <= _now) {
+            //已经到期
+            append(_ready, node);
+        } else {
+            place(node);
+        }
+        return Handle(node, node->seq);
+    }
+
+    /**
+     * 取消定时器，从所在的槽中摘除并回收，携带的数据随之析构
+     * 可以在到期回调中调用，取消本轮尚未触发的定时器
+     * @param handle add返回的定时器句柄
+     * @return 定时器已到期或已被取消时返回false
+     */
+    bool cancel(const Handle &handle) {
+        auto node = handle._node;
+        if (!node || node->seq != handle._seq || !node->slot) {
+            return false;
+        }
+        auto slot = node->slot;
+        unlink(*slot, node);
+        if (!slot->head && slot->bitmap) {
+            //槽已清空
+            *slot->bitmap &= ~slot->bit;
+        }
+        --_size;
+        recycleNode(node);
+        return true;
+    }
+
+    /**
+     * 推进时间，触发所有已到期的定时器
+     * 回调中可以再次调用add
+     * @param now_ms 当前时间，单位毫秒
+     * @param on_expire 到期回调，参数为T &
+     */
+    template<typename FUNC>
+    void advance(uint64_t now_ms, FUNC &&on_expire) {
+        fire(_ready, on_expire);
+        while (_now < now_ms) {
+            if (!_size) {
+                //没有定时器，直接跳到当前时间
+                _now = now_ms;
+                break;
+            }
+            //第0层下次回绕的时间点，此时需要从上层分配定时器下来
+            auto boundary = (_now | kMask0) + 1;
+            auto limit = std::min(now_ms, boundary);
+            //查找(_now, limit]之间第一个非空的槽
+            auto next = _now + 1 + findNext0((_now + 1) & kMask0, limit - _now - 1);
+            _now = std::min(next, limit);
+            if (!(_now & kMask0)) {
+                cascade();
+            }
+            fire(_slots0[_now & kMask0], on_expire);
+        }
+        fire(_ready, on_expire);
+    }
+
+    /**
+     * 获取距离下次需要调用advance的毫秒数
+     * @param now_ms 当前时间，单位毫秒
+     * @return 0代表没有定时器
+     */
+    uint64_t nextDelay(uint64_t now_ms) const {
+        if (!_size) {
+            return 0;
+        }
+        if (_ready.head) {
+            return 1;
+        }
+        uint64_t ret = UINT64_MAX;
+        //第0层的定时器在对应的槽到期，当前槽已经触发过，故只需查找之后的255个槽
+        auto d0 = findNext0((_now + 1) & kMask0, kSlots0 - 1);
+        if (d0 < kSlots0 - 1) {
+            ret = _now + 1 + d0;
+        }
+        //上层的定时器在对应的槽被分配下来时需要唤醒
+        for (size_t level = 0; level < kLevels; ++level) {
+            if (!_bitmap[level]) {
+                continue;
+            }
+            auto shift = kBits0 + level * kBits;
+            auto index = (_now >> shift) & kMask;
+            //循环查找下一个非空的槽，距离为1~64
+            auto bits = rotr(_bitmap[level], (index + 1) & kMask);
+            auto distance = ctz(bits) + 1;
+            auto time = ((_now >> shift) + distance) << shift;
+            ret = std::min(ret, time);
+        }
+        return ret > now_ms ? ret - now_ms : 1;
+    }
+
+    /**
+     * 定时器个数
+     */
+    size_t size() const {
+        return _size;
+    }
+
+    bool empty() const {
+        return !_size;
+    }
+
+private:
+    struct Slot;
+
+    struct Node {
+        Node *prev = nullptr;
+        Node *next = nullptr;
+        //所在的槽，已到期或已回收时为nullptr
+        Slot *slot = nullptr;
+        //每次回收时递增，用于识别失效的句柄
+        uint64_t seq = 0;
+        uint64_t expire = 0;
+        T value;
+    };
+
+    struct Slot {
+        Node *head = nullptr;
+        Node *tail = nullptr;
+        //该槽在位图中对应的位，_ready与_firing不使用位图
+        uint64_t *bitmap = nullptr;
+        uint64_t bit = 0;
+    };
+
+    static constexpr size_t kBits0 = 8;
+    static constexpr size_t kSlots0 = 1 << kBits0;
+    static constexpr uint64_t kMask0 = kSlots0 - 1;
+    static constexpr size_t kBits = 6;
+    static constexpr size_t kSlots = 1 << kBits;
+    static constexpr uint64_t kMask = kSlots - 1;
+    static constexpr size_t kLevels = 4;
+    //最大可表示的超时
+    static constexpr uint64_t kMaxDelta = (1ULL << (kBits0 + kLevels * kBits)) - 1;
+
+    static size_t ctz(uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_ctzll(v);
+#else
+        size_t ret = 0;
+        while (!(v & 1)) {
+            v >>= 1;
+            ++ret;
+        }
+        return ret;
+#endif
+    }
+
+    static uint64_t rotr(uint64_t v, size_t n) {
+        return n ? (v >> n) | (v << (64 - n)) : v;
+    }
+
+    /**
+     * 从第0层的start槽开始(循环)，在max个槽以内查找第一个非空的槽
+     * @return 与start的距离，未找到时返回max
+     */
+    size_t findNext0(uint64_t start, size_t max) const {
+        size_t distance = 0;
+        while (distance < max) {
+            auto index = (start + distance) & kMask0;
+            auto word = _bitmap0[index >> 6] >> (index & 63);
+            if (word) {
+                distance += ctz(word);
+                return std::min(distance, max);
+            }
+            distance += 64 - (index & 63);
+        }
+        return max;
+    }
+
+    Node *allocNode() {
+        if (!_free_nodes) {
+            return new Node;
+        }
+        auto ret = _free_nodes;
+        _free_nodes = ret->next;
+        ret->next = nullptr;
+        return ret;
+    }
+
+    void recycleNode(Node *node) {
+        node->value = T();
+        node->prev = nullptr;
+        node->slot = nullptr;
+        ++node->seq;
+        node->next = _free_nodes;
+        _free_nodes = node;
+    }
+
+    static void freeList(Node *node) {
+        while (node) {
+            auto next = node->next;
+            delete node;
+            node = next;
+        }
+    }
+
+    static void append(Slot &slot, Node *node) {
+        node->prev = slot.tail;
+        node->next = nullptr;
+        node->slot = &slot;
+        if (slot.tail) {
+            slot.tail->next = node;
+        } else {
+            slot.head = node;
+        }
+        slot.tail = node;
+        if (slot.bitmap) {
+            *slot.bitmap |= slot.bit;
+        }
+    }
+
+    static void unlink(Slot &slot, Node *node) {
+        if (node->prev) {
+            node->prev->next = node->next;
+        } else {
+            slot.head = node->next;
+        }
+        if (node->next) {
+            node->next->prev = node->prev;
+        } else {
+            slot.tail = node->prev;
+        }
+        node->prev = node->next = nullptr;
+        node->slot = nullptr;
+    }
+
+    //摘下整个链表，调用前需确保to为空
+    static void moveList(Slot &from, Slot &to) {
+        to.head = from.head;
+        to.tail = from.tail;
+        from.head = from.tail = nullptr;
+        if (from.bitmap) {
+            *from.bitmap &= ~from.bit;
+        }
+        for (auto node = to.head; node; node = node->next) {
+            node->slot = &to;
+        }
+    }
+
+    //根据到期时间把定时器放入对应层的槽，调用前需确保expire >= _now
+    void place(Node *node) {
+        auto delta = node->expire - _now;
+        if (delta < kSlots0) {
+            append(_slots0[node->expire & kMask0], node);
+            return;
+        }
+        //超出最大范围的定时器放在最高层，被分配下来时再重新放置
+        auto expire = delta > kMaxDelta ? _now + kMaxDelta : node->expire;
+        delta = expire - _now;
+        size_t level = 0;
+        while (level + 1 < kLevels && delta >= (1ULL << (kBits0 + (level + 1) * kBits))) {
+            ++level;
+        }
+        append(_slots[level][(expire >> (kBits0 + level * kBits)) & kMask], node);
+    }
+
+    //第0层回绕，把上层对应槽中的定时器重新分配
+    void cascade() {
+        for (size_t level = 0; level < kLevels; ++level) {
+            auto shift = kBits0 + level * kBits;
+            auto index = (_now >> shift) & kMask;
+            auto &slot = _slots[level][index];
+            auto node = slot.head;
+            slot.head = slot.tail = nullptr;
+            *slot.bitmap &= ~slot.bit;
+            while (node) {
+                auto next = node->next;
+                place(node);
+                node = next;
+            }
+            if (index) {
+                //本层尚未回绕，更上层无需分配
+                break;
+            }
+        }
+    }
+
+    template<typename FUNC>
+    void fire(Slot &slot, FUNC &on_expire) {
+        if (!slot.head) {
+            return;
+        }
+        //先把整个链表移到_firing，回调中可能添加新的定时器，也可能取消本轮尚未触发的定时器
+        moveList(slot, _firing);
+        while (auto node = _firing.head) {
+            unlink(_firing, node);
+            --_size;
+            T value = std::move(node->value);
+            recycleNode(node);
+            on_expire(value);
+        }
+    }
+
+private:
+    //当前时间，该时间及之前到期的定时器均已触发
+    uint64_t _now;
+    size_t _size = 0;
+    Node *_free_nodes = nullptr;
+    //添加时已经到期的定时器
+    Slot _ready;
+    //正在触发的定时器
+    Slot _firing;
+    Slot _slots0[kSlots0];
+    uint64_t _bitmap0[kSlots0 / 64] = {0};
+    Slot _slots[kLevels][kSlots];
+    uint64_t _bitmap[kLevels] = {0};
+};
+
+} /* namespace toolkit */
+#endif //ZLTOOLKIT_TIMINGWHEEL_H
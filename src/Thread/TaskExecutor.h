@@ -11,8 +11,11 @@
 #ifndef ZLTOOLKIT_TASKEXECUTOR_H
 #define ZLTOOLKIT_TASKEXECUTOR_H
 
+#include <atomic>
 #include <memory>
+#include <thread>
 #include <functional>
+#include "TaskNode.h"
 #include "Util/List.h"
 #include "Util/util.h"
 #include "Util/onceToken.h"
@@ -23,18 +26,26 @@ namespace toolkit {
 
 /**
  * cpu负载计算器
+ * 拥有者线程在休眠与唤醒时更新累计运行时间，并定期记录快照至固定大小的环形缓冲；
+ * 其他线程通过顺序锁无锁读取，对比当前累计运行时间与时间窗口起点的快照即可得出负载率
  */
 class ThreadLoadCounter {
 public:
     /**
      * 构造函数
-     * @param max_size 统计样本数量
+     * @param max_size 统计样本数量，亦即快照环形缓冲的大小
      * @param max_usec 统计时间窗口,亦即最近{max_usec}的cpu负载率
      */
     ThreadLoadCounter(uint64_t max_size,uint64_t max_usec){
-        _last_sleep_time = _last_wake_time = getCurrentMicrosecond();
-        _max_size = max_size;
+        _max_size = max_size > 1 ? max_size : 2;
         _max_usec = max_usec;
+        _snap_interval = max_usec / _max_size;
+        _snapshots.reset(new Snapshot[_max_size]);
+        auto now = getCurrentMicrosecond();
+        _last_time.store(now, memory_order_relaxed);
+        _last_snap_time = now;
+        _snapshots[0].time.store(now, memory_order_relaxed);
+        _snap_pos.store(1, memory_order_relaxed);
     }
     ~ThreadLoadCounter(){}
 
@@ -42,101 +53,171 @@ public:
      * 线程进入休眠
      */
     void startSleep(){
-        lock_guard<mutex> lck(_mtx);
-
-        _sleeping = true;
-
-        auto current_time = getCurrentMicrosecond();
-        auto run_time = current_time - _last_wake_time;
-        _last_sleep_time = current_time;
-
-        _time_list.emplace_back(run_time, false);
-
-        if(_time_list.size() > _max_size){
-            _time_list.pop_front();
-        }
+        update(STATE_SLEEP);
     }
 
     /**
      * 休眠唤醒,结束休眠
      */
     void sleepWakeUp(){
-        lock_guard<mutex> lck(_mtx);
-
-        _sleeping = false;
-
-        auto current_time = getCurrentMicrosecond();
-        auto sleep_time = current_time - _last_sleep_time;
-        _last_wake_time = current_time;
-
-        _time_list.emplace_back(sleep_time, true);
+        update(STATE_RUN);
+    }
 
-        if(_time_list.size() > _max_size){
-            _time_list.pop_front();
-        }
+    /**
+     * 线程进入忙轮询，该时间不计入load()，单独由spinLoad()统计
+     */
+    void startSpin(){
+        update(STATE_SPIN);
     }
 
     /**
      * 返回当前线程cpu使用率，范围为 0 ~ 100
+     * 忙轮询的时间视为空闲，不计入其中
      * @return 当前线程cpu使用率
      */
     int load(){
-        lock_guard<mutex> lck(_mtx);
+        return loadOf(false);
+    }
 
-        uint64_t totalSleepTime = 0;
-        uint64_t totalRunTime = 0;
+    /**
+     * 返回当前线程忙轮询占用的cpu比例，范围为 0 ~ 100
+     */
+    int spinLoad(){
+        return loadOf(true);
+    }
+
+private:
+    enum {
+        STATE_RUN = 0,
+        STATE_SLEEP,
+        STATE_SPIN,
+    };
 
-        _time_list.for_each([&](const TimeRecord& rcd){
-            if(rcd._sleep){
-                totalSleepTime += rcd._time;
-            }else{
-                totalRunTime += rcd._time;
+    int loadOf(bool spin){
+        uint64_t run_time, snap_run, snap_time, now;
+        uint32_t seq;
+        do {
+            seq = _seq.load(memory_order_acquire);
+            if (seq & 1) {
+                //拥有者线程正在更新
+                this_thread::yield();
+                continue;
             }
-        });
+            now = getCurrentMicrosecond();
+            auto &total = spin ? _spin_time : _run_time;
+            run_time = total.load(memory_order_relaxed);
+            if (_state.load(memory_order_relaxed) == (spin ? STATE_SPIN : STATE_RUN)) {
+                auto last_time = _last_time.load(memory_order_relaxed);
+                run_time += now > last_time ? now - last_time : 0;
+            }
+            //选取时间窗口内最早的快照，没有则选取最近的快照
+            snap_time = 0;
+            snap_run = 0;
+            uint64_t newest_time = 0, newest_run = 0;
+            for (size_t i = 0; i < _max_size; ++i) {
+                auto time = _snapshots[i].time.load(memory_order_relaxed);
+                if (!time) {
+                    continue;
+                }
+                auto &snap = spin ? _snapshots[i].spin_time : _snapshots[i].run_time;
+                if (time + _max_usec >= now && (!snap_time || time < snap_time)) {
+                    snap_time = time;
+                    snap_run = snap.load(memory_order_relaxed);
+                }
+                if (time > newest_time) {
+                    newest_time = time;
+                    newest_run = snap.load(memory_order_relaxed);
+                }
+            }
+            if (!snap_time) {
+                snap_time = newest_time;
+                snap_run = newest_run;
+            }
+            atomic_thread_fence(memory_order_acquire);
+        } while ((seq & 1) || seq != _seq.load(memory_order_relaxed));
 
-        if(_sleeping){
-            totalSleepTime += (getCurrentMicrosecond() - _last_sleep_time);
-        }else{
-            totalRunTime += (getCurrentMicrosecond() - _last_wake_time);
+        if (now <= snap_time || run_time < snap_run) {
+            return 0;
         }
+        auto ret = (run_time - snap_run) * 100 / (now - snap_time);
+        return (int) (ret > 100 ? 100 : ret);
+    }
 
-        uint64_t totalTime = totalRunTime + totalSleepTime;
+    void update(int state) {
+        auto now = getCurrentMicrosecond();
+        //仅有一个线程更新时该CAS不会失败；ThreadPool等多线程共用本对象时借此串行化
+        auto seq = _seq.load(memory_order_relaxed);
+        size_t spin = 1;
+        while ((seq & 1) || !_seq.compare_exchange_weak(seq, seq + 1, memory_order_acquire, memory_order_relaxed)) {
+            //其他线程正在更新，指数退避，避免多个写者在同一缓存行上反复争抢
+            backoff(spin);
+            seq = _seq.load(memory_order_relaxed);
+        }
+        atomic_thread_fence(memory_order_release);
 
-        while((_time_list.size() != 0) && (totalTime > _max_usec || _time_list.size() > _max_size)){
-            TimeRecord &rcd = _time_list.front();
-            if(rcd._sleep){
-                totalSleepTime -= rcd._time;
-            }else{
-                totalRunTime -= rcd._time;
-            }
-            totalTime -= rcd._time;
-            _time_list.pop_front();
+        auto last_time = _last_time.load(memory_order_relaxed);
+        auto old_state = _state.load(memory_order_relaxed);
+        if (old_state != STATE_SLEEP && now > last_time) {
+            auto &total = old_state == STATE_SPIN ? _spin_time : _run_time;
+            total.store(total.load(memory_order_relaxed) + now - last_time, memory_order_relaxed);
         }
-        if(totalTime == 0){
-            return 0;
+        _state.store(state, memory_order_relaxed);
+        _last_time.store(now, memory_order_relaxed);
+        if (now - _last_snap_time >= _snap_interval) {
+            //记录快照，覆盖最旧的快照
+            auto pos = _snap_pos.load(memory_order_relaxed);
+            _snapshots[pos].time.store(now, memory_order_relaxed);
+            _snapshots[pos].run_time.store(_run_time.load(memory_order_relaxed), memory_order_relaxed);
+            _snapshots[pos].spin_time.store(_spin_time.load(memory_order_relaxed), memory_order_relaxed);
+            _snap_pos.store((pos + 1) % _max_size, memory_order_relaxed);
+            _last_snap_time = now;
         }
-        return (int)(totalRunTime * 100 / totalTime);
+        _seq.store(seq + 2, memory_order_release);
     }
 
-private:
-    class TimeRecord {
-    public:
-        TimeRecord(uint64_t tm,bool slp){
-            _time = tm;
-            _sleep = slp;
+    static void backoff(size_t &spin) {
+        if (spin > kMaxBackoffSpin) {
+            //更新者可能已被调度出去，让出cpu
+            this_thread::yield();
+            return;
         }
-    public:
-        uint64_t _time;
-        bool _sleep;
+        for (size_t i = 0; i < spin; ++i) {
+#if defined(__i386__) || defined(__x86_64__)
+            __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+            asm volatile("yield");
+#endif
+        }
+        spin <<= 1;
+    }
+
+private:
+    //退避时最多连续执行的pause指令个数，超过后改为让出cpu
+    static constexpr size_t kMaxBackoffSpin = 64;
+
+    struct Snapshot {
+        atomic<uint64_t> time{0};
+        atomic<uint64_t> run_time{0};
+        atomic<uint64_t> spin_time{0};
     };
+
 private:
-    uint64_t _last_sleep_time;
-    uint64_t _last_wake_time;
-    List<TimeRecord> _time_list;
-    bool _sleeping = true;
+    //顺序锁，奇数代表正在更新
+    atomic<uint32_t> _seq{0};
+    atomic<int> _state{STATE_SLEEP};
+    //最近一次休眠或唤醒的时间
+    atomic<uint64_t> _last_time{0};
+    //累计运行时间
+    atomic<uint64_t> _run_time{0};
+    //累计忙轮询时间
+    atomic<uint64_t> _spin_time{0};
+    atomic<size_t> _snap_pos{0};
+    std::unique_ptr<Snapshot[]> _snapshots;
+    //以下成员只在更新时访问
+    uint64_t _last_snap_time;
+    uint64_t _snap_interval;
     uint64_t _max_size;
     uint64_t _max_usec;
-    mutex _mtx;
 };
 
 class TaskCancelable : public noncopyable{
@@ -228,6 +309,28 @@ public:
         return async(std::move(task),may_sync);
     };
 
+    /**
+     * 同async方法，但是不返回可取消的任务，也不经过function包装
+     * 可调用对象较小时直接存放在侵入式任务节点中，执行器支持任务节点时投递通常不需要任何内存分配
+     * @param func 任务，签名为void()
+     * @param may_sync 是否允许同步执行该任务
+     */
+    template<typename FUNC>
+    void post(FUNC &&func, bool may_sync = true) {
+        postNode(TaskNode::create(std::forward<FUNC>(func)), may_sync);
+    }
+
+    /**
+     * 投递任务节点，节点执行后或执行器销毁时由执行器负责回收
+     * 默认包装为async任务，执行器重载本方法后可以省去Task与function的内存分配
+     * @param node 任务节点
+     * @param may_sync 是否允许同步执行该任务
+     */
+    virtual void postNode(TaskNode *node, bool may_sync) {
+        std::shared_ptr<TaskNode> holder(node, TaskNode::recycle);
+        async([holder]() { holder->run(); }, may_sync);
+    }
+
     /**
      * 同步执行任务
      * @param task
@@ -281,6 +384,11 @@ public:
      */
     TaskExecutor(uint64_t max_size = 32,uint64_t max_usec = 2 * 1000 * 1000):ThreadLoadCounter(max_size,max_usec){}
     ~TaskExecutor(){}
+
+    /**
+     * 获取尚未执行的任务个数，用于按列队深度选择执行器，可能为近似值
+     */
+    virtual size_t taskCount() { return 0; }
 };
 
 class TaskExecutorGetter {
@@ -296,40 +404,59 @@ public:
 
 class TaskExecutorGetterImp : public TaskExecutorGetter{
 public:
+    /**
+     * 任务执行器选择策略
+     */
+    enum Policy {
+        //遍历所有执行器，选择负载率最低的，复杂度O(N)
+        POLICY_MIN_LOAD = 0,
+        //轮流选择
+        POLICY_ROUND_ROBIN,
+        //随机选取两个执行器，选择负载率较低的
+        POLICY_TWO_CHOICES,
+        //随机选取两个执行器，选择待执行任务较少的，任务数相同时选择负载率较低的
+        POLICY_QUEUE_DEPTH,
+    };
+
     TaskExecutorGetterImp(){}
     ~TaskExecutorGetterImp(){}
 
     /**
-     * 根据线程负载情况，获取最空闲的任务执行器
+     * 设置getExecutor的选择策略，默认为POLICY_MIN_LOAD
+     */
+    void setPolicy(Policy policy){
+        _policy = policy;
+    }
+
+    /**
+     * 根据选择策略与线程负载情况，获取任务执行器
      * @return 任务执行器
      */
     TaskExecutor::Ptr getExecutor() override{
-        auto thread_pos = _thread_pos;
-        if(thread_pos >= _threads.size()){
-            thread_pos = 0;
-        }
-
-        TaskExecutor::Ptr executor_min_load = _threads[thread_pos];
-        auto min_load = executor_min_load->load();
-
-        for(size_t i = 0; i < _threads.size() ; ++i , ++thread_pos ){
-            if(thread_pos >= _threads.size()){
-                thread_pos = 0;
-            }
-
-            auto th = _threads[thread_pos];
-            auto load = th->load();
-
-            if(load < min_load){
-                min_load = load;
-                executor_min_load = th;
-            }
-            if(min_load == 0){
-                break;
+        auto size = _threads.size();
+        auto policy = size < 2 ? POLICY_ROUND_ROBIN : _policy.load(memory_order_relaxed);
+        switch (policy) {
+            case POLICY_ROUND_ROBIN: return _threads[_round_robin.fetch_add(1, memory_order_relaxed) % size];
+            case POLICY_TWO_CHOICES:
+            case POLICY_QUEUE_DEPTH: {
+                auto first = fastRandom() % size;
+                auto second = fastRandom() % (size - 1);
+                if (second >= first) {
+                    ++second;
+                }
+                auto &a = _threads[first];
+                auto &b = _threads[second];
+                if (policy == POLICY_QUEUE_DEPTH) {
+                    auto count_a = a->taskCount();
+                    auto count_b = b->taskCount();
+                    if (count_a != count_b) {
+                        return count_a < count_b ? a : b;
+                    }
+                }
+                return a->load() <= b->load() ? a : b;
             }
+            default: return getMinLoadExecutor();
         }
-        _thread_pos = thread_pos;
-        return executor_min_load;
     }
 
     /**
@@ -373,6 +500,49 @@ public:
         }
     }
 protected:
+    /**
+     * 遍历所有执行器，获取负载率最低的
+     */
+    TaskExecutor::Ptr getMinLoadExecutor(){
+        auto thread_pos = _thread_pos;
+        if(thread_pos >= _threads.size()){
+            thread_pos = 0;
+        }
+
+        TaskExecutor::Ptr executor_min_load = _threads[thread_pos];
+        auto min_load = executor_min_load->load();
+
+        for(size_t i = 0; i < _threads.size() ; ++i , ++thread_pos ){
+            if(thread_pos >= _threads.size()){
+                thread_pos = 0;
+            }
+
+            auto th = _threads[thread_pos];
+            auto load = th->load();
+
+            if(load < min_load){
+                min_load = load;
+                executor_min_load = th;
+            }
+            if(min_load == 0){
+                break;
+            }
+        }
+        _thread_pos = thread_pos;
+        return executor_min_load;
+    }
+
+    /**
+     * 线程内的xorshift随机数，避免多线程竞争同一个随机数生成器
+     */
+    static uint64_t fastRandom(){
+        static thread_local uint64_t s_seed = getCurrentMicrosecond() ^ (uint64_t) (uintptr_t) &s_seed;
+        s_seed ^= s_seed << 13;
+        s_seed ^= s_seed >> 7;
+        s_seed ^= s_seed << 17;
+        return s_seed;
+    }
+
     /**
      *
      * @tparam FUN 任务执行器创建方式
@@ -387,6 +557,8 @@ protected:
     }
 protected:
     size_t _thread_pos = 0;
+    atomic<size_t> _round_robin{0};
+    atomic<Policy> _policy{POLICY_MIN_LOAD};
     vector <TaskExecutor::Ptr > _threads;
 };
 
@@ -0,0 +1,139 @@
+﻿/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/xia-chu/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "TaskNode.h"
+
+namespace toolkit {
+
+//每个线程最多缓存的空闲节点个数
+static constexpr size_t kMaxCachedNode = 1024;
+//与全局仓库交换节点时每批的节点个数
+static constexpr size_t kBatchNode = 256;
+//全局仓库最多保存的批数
+static constexpr size_t kDepotSlot = 64;
+
+//累计从堆上分配的节点个数
+static atomic<uint64_t> s_heap_count{0};
+
+//全局仓库，每个槽位存放一批kBatchNode个节点组成的链表
+//跨线程投递时节点在生产者线程分配、在消费者线程回收，消费者缓存满后整批交还仓库，生产者缓存空时从仓库整批获取
+//槽位通过exchange/compare_exchange整体转移所有权，无锁且没有ABA问题
+static atomic<TaskNode *> s_depot[kDepotSlot];
+
+//线程退出时缓存已经析构，此后回收的节点直接释放
+static thread_local bool s_cache_destroyed = false;
+
+class TaskNodeCache {
+public:
+    ~TaskNodeCache() {
+        s_cache_destroyed = true;
+        freeList(_head);
+    }
+
+    TaskNode *obtain() {
+        if (!_head) {
+            _head = takeBatch();
+            if (!_head) {
+                s_heap_count.fetch_add(1, memory_order_relaxed);
+                return new TaskNode;
+            }
+            _size = kBatchNode;
+        }
+        auto ret = _head;
+        _head = ret->_next.load(memory_order_relaxed);
+        ret->_next.store(nullptr, memory_order_relaxed);
+        --_size;
+        return ret;
+    }
+
+    void recycle(TaskNode *node) {
+        if (_size >= kMaxCachedNode) {
+            //缓存已满，摘下一批交还全局仓库
+            auto batch = _head;
+            auto tail = _head;
+            for (size_t i = 1; i < kBatchNode; ++i) {
+                tail = tail->_next.load(memory_order_relaxed);
+            }
+            _head = tail->_next.load(memory_order_relaxed);
+            tail->_next.store(nullptr, memory_order_relaxed);
+            _size -= kBatchNode;
+            if (!putBatch(batch)) {
+                freeList(batch);
+            }
+        }
+        node->_next.store(_head, memory_order_relaxed);
+        _head = node;
+        ++_size;
+    }
+
+private:
+    static TaskNode *takeBatch() {
+        for (auto &slot : s_depot) {
+            if (slot.load(memory_order_relaxed)) {
+                auto ret = slot.exchange(nullptr, memory_order_acquire);
+                if (ret) {
+                    return ret;
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    static bool putBatch(TaskNode *batch) {
+        for (auto &slot : s_depot) {
+            TaskNode *expected = nullptr;
+            if (!slot.load(memory_order_relaxed) && slot.compare_exchange_strong(expected, batch, memory_order_release, memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static void freeList(TaskNode *node) {
+        while (node) {
+            auto next = node->_next.load(memory_order_relaxed);
+            delete node;
+            node = next;
+        }
+    }
+
+private:
+    TaskNode *_head = nullptr;
+    size_t _size = 0;
+};
+
+static thread_local TaskNodeCache s_cache;
+
+TaskNode *TaskNode::obtain() {
+    if (s_cache_destroyed) {
+        s_heap_count.fetch_add(1, memory_order_relaxed);
+        return new TaskNode;
+    }
+    return s_cache.obtain();
+}
+
+void TaskNode::recycle(TaskNode *node) {
+    auto invoker = node->_invoker;
+    if (invoker) {
+        node->_invoker = nullptr;
+        invoker(node, false);
+    }
+    if (s_cache_destroyed) {
+        delete node;
+        return;
+    }
+    s_cache.recycle(node);
+}
+
+uint64_t TaskNode::getHeapCount() {
+    return s_heap_count.load(memory_order_relaxed);
+}
+
+} /* namespace toolkit */
@@ -0,0 +1,316 @@
+﻿/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/xia-chu/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLTOOLKIT_TASKNODE_H
+#define ZLTOOLKIT_TASKNODE_H
+
+#include <atomic>
+#include <thread>
+#include <utility>
+#include <type_traits>
+#include "Util/MPSCQueue.h"
+using namespace std;
+
+namespace toolkit {
+
+/**
+ * 侵入式任务节点，用于跨线程投递任务
+ * 可调用对象不超过kInlineSize字节时直接存放在节点内部，否则才在堆上分配；
+ * 节点本身带有列队链接指针，并在每个线程内缓存回收的节点，缓存满或空时与全局仓库整批交换，
+ * 所以跨线程投递时消费者回收的节点也能回到生产者线程，投递小lambda通常不需要任何内存分配
+ * 本对象不提供取消功能，需要取消时请在可调用对象中持有Task::Ptr
+ */
+class TaskNode {
+public:
+    //可调用对象内联存储的最大字节数，使整个节点正好占用一个缓存行
+    static constexpr size_t kInlineSize = 48;
+
+    /**
+     * 创建任务节点
+     * @param func 可调用对象，签名为void()
+     */
+    template<typename FUNC>
+    static TaskNode *create(FUNC &&func) {
+        typedef typename std::decay<FUNC>::type F;
+        auto node = obtain();
+        Storage<F, (sizeof(F) <= kInlineSize && alignof(F) <= alignof(Buffer))>::create(node, std::forward<FUNC>(func));
+        return node;
+    }
+
+    /**
+     * 回收任务节点，尚未执行的可调用对象将被析构
+     */
+    static void recycle(TaskNode *node);
+
+    /**
+     * 获取累计从堆上分配的节点个数，用于评估节点复用率
+     */
+    static uint64_t getHeapCount();
+
+    /**
+     * 执行并析构可调用对象，异常将抛给调用者
+     */
+    void run() {
+        auto invoker = _invoker;
+        _invoker = nullptr;
+        invoker(this, true);
+    }
+
+private:
+    friend struct TaskNodePolicy;
+    friend class TaskNodeList;
+    friend class TaskNodeStack;
+    friend class TaskNodeCache;
+
+    typedef typename std::aligned_storage<kInlineSize>::type Buffer;
+    //run为false时只析构可调用对象
+    typedef void (*Invoker)(TaskNode *node, bool run);
+
+    TaskNode() = default;
+    ~TaskNode() = default;
+
+    static TaskNode *obtain();
+
+    template<typename F>
+    struct Destroyer {
+        F *func;
+        bool inline_storage;
+
+        ~Destroyer() {
+            if (inline_storage) {
+                func->~F();
+            } else {
+                delete func;
+            }
+        }
+    };
+
+    template<typename F, bool INLINE>
+    struct Storage;
+
+    template<typename F>
+    struct Storage<F, true> {
+        template<typename FUNC>
+        static void create(TaskNode *node, FUNC &&func) {
+            new (&node->_buffer) F(std::forward<FUNC>(func));
+            node->_invoker = invoke;
+        }
+
+        static void invoke(TaskNode *node, bool run) {
+            //即便抛异常也要析构可调用对象
+            Destroyer<F> destroyer{reinterpret_cast<F *>(&node->_buffer), true};
+            if (run) {
+                (*destroyer.func)();
+            }
+        }
+    };
+
+    template<typename F>
+    struct Storage<F, false> {
+        template<typename FUNC>
+        static void create(TaskNode *node, FUNC &&func) {
+            node->_heap = new F(std::forward<FUNC>(func));
+            node->_invoker = invoke;
+        }
+
+        static void invoke(TaskNode *node, bool run) {
+            Destroyer<F> destroyer{static_cast<F *>(node->_heap), false};
+            if (run) {
+                (*destroyer.func)();
+            }
+        }
+    };
+
+private:
+    //列队链接指针
+    atomic<TaskNode *> _next{nullptr};
+    Invoker _invoker = nullptr;
+    union {
+        Buffer _buffer;
+        void *_heap;
+    };
+};
+
+//TaskNode在IntrusiveMPSCQueue中的节点策略，节点从线程缓存获取与回收
+struct TaskNodePolicy {
+    static TaskNode *obtain() {
+        return TaskNode::obtain();
+    }
+
+    static void recycle(TaskNode *node) {
+        TaskNode::recycle(node);
+    }
+
+    static atomic<TaskNode *> &next(TaskNode *node) {
+        return node->_next;
+    }
+};
+
+/**
+ * 侵入式无锁多生产者单消费者任务列队，先进先出
+ * 最后一个被消费的节点作为哨兵节点，下次消费时才回收，所以消费函数中必须执行完任务，不能转移节点的所有权
+ */
+typedef IntrusiveMPSCQueue<TaskNode, TaskNodePolicy> TaskNodeQueue;
+
+/**
+ * 侵入式任务链表，先进先出，非线程安全
+ * 接口与List相同，供TaskQueue使用，加锁入列与出列时不需要为每个任务分配链表节点
+ * 出列的节点所有权转移给调用者，执行后需要调用TaskNode::recycle回收
+ */
+class TaskNodeList {
+public:
+    TaskNodeList() = default;
+
+    ~TaskNodeList() {
+        while (_front) {
+            TaskNode::recycle(popFront());
+        }
+    }
+
+    TaskNodeList(const TaskNodeList &that) = delete;
+    TaskNodeList &operator=(const TaskNodeList &that) = delete;
+
+    void emplace_back(TaskNode *node) {
+        node->_next.store(nullptr, memory_order_relaxed);
+        if (_back) {
+            _back->_next.store(node, memory_order_relaxed);
+        } else {
+            _front = node;
+        }
+        _back = node;
+        ++_size;
+    }
+
+    void emplace_front(TaskNode *node) {
+        node->_next.store(_front, memory_order_relaxed);
+        _front = node;
+        if (!_back) {
+            _back = node;
+        }
+        ++_size;
+    }
+
+    TaskNode *&front() {
+        return _front;
+    }
+
+    void pop_front() {
+        popFront();
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+private:
+    TaskNode *popFront() {
+        auto ret = _front;
+        _front = ret->_next.load(memory_order_relaxed);
+        if (!_front) {
+            _back = nullptr;
+        }
+        ret->_next.store(nullptr, memory_order_relaxed);
+        --_size;
+        return ret;
+    }
+
+private:
+    TaskNode *_front = nullptr;
+    TaskNode *_back = nullptr;
+    size_t _size = 0;
+};
+
+/**
+ * 侵入式无锁多生产者单消费者任务栈，后进先出
+ * 消费者一次性取走所有节点，所以不存在ABA问题
+ */
+class TaskNodeStack {
+public:
+    TaskNodeStack() = default;
+
+    ~TaskNodeStack() {
+        auto node = _head.exchange(nullptr);
+        while (node) {
+            auto next = node->_next.load(memory_order_relaxed);
+            TaskNode::recycle(node);
+            node = next;
+        }
+    }
+
+    TaskNodeStack(const TaskNodeStack &that) = delete;
+    TaskNodeStack &operator=(const TaskNodeStack &that) = delete;
+
+    /**
+     * 入栈，可以在任意线程调用
+     */
+    void push(TaskNode *node) {
+        //使用seq_cst，保证与调用者随后的唤醒标记操作之间的顺序
+        auto head = _head.load(memory_order_relaxed);
+        do {
+            node->_next.store(head, memory_order_relaxed);
+        } while (!_head.compare_exchange_weak(head, node, memory_order_seq_cst, memory_order_relaxed));
+    }
+
+    /**
+     * 按后进先出顺序消费所有节点，只能在消费者线程调用
+     * @param func 消费函数，参数为TaskNode &，节点由本对象负责回收
+     * @return 消费的节点个数
+     */
+    template<typename FUNC>
+    size_t consume(FUNC &&func) {
+        auto node = _head.exchange(nullptr);
+        size_t count = 0;
+        while (node) {
+            auto next = node->_next.load(memory_order_relaxed);
+            ++count;
+            func(*node);
+            TaskNode::recycle(node);
+            node = next;
+        }
+        return count;
+    }
+
+    /**
+     * 按入栈顺序(先进先出)取出所有节点，只能在消费者线程调用
+     * @param func 消费函数，参数为TaskNode *，节点所有权转移给消费函数，执行后需要调用TaskNode::recycle回收
+     * @return 取出的节点个数
+     */
+    template<typename FUNC>
+    size_t take(FUNC &&func) {
+        //栈中为后进先出，先反转链表
+        auto node = _head.exchange(nullptr);
+        TaskNode *head = nullptr;
+        while (node) {
+            auto next = node->_next.load(memory_order_relaxed);
+            node->_next.store(head, memory_order_relaxed);
+            head = node;
+            node = next;
+        }
+        size_t count = 0;
+        while (head) {
+            auto next = head->_next.load(memory_order_relaxed);
+            head->_next.store(nullptr, memory_order_relaxed);
+            ++count;
+            func(head);
+            head = next;
+        }
+        return count;
+    }
+
+    bool empty() const {
+        return !_head.load(memory_order_relaxed);
+    }
+
+private:
+    atomic<TaskNode *> _head{nullptr};
+};
+
+} /* namespace toolkit */
+#endif //ZLTOOLKIT_TASKNODE_H
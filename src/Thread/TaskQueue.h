@@ -23,7 +23,8 @@ using namespace std;
 namespace toolkit {
 
 //实现了一个基于函数对象的任务列队，该列队是线程安全的，任务列队任务数由信号量控制
-template<typename T>
+//CONTAINER为存放任务的容器，接口需与List相同，存放TaskNode时可以使用侵入式的TaskNodeList
+template<typename T, typename CONTAINER = List<T> >
 class TaskQueue {
 public:
     //打入任务至列队
@@ -67,7 +68,7 @@ private:
     //经过对比List,std::list,std::deque三种容器发现，
     //在i5-6200U单线程环境下，执行1000万个任务时，分别耗时1.3，2.4，1.8秒左右
     //所以此处我们替换成性能最好的List模板
-    List<T> _queue;
+    CONTAINER _queue;
     mutable mutex _mutex;
     semaphore _sem;
 };
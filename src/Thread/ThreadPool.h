@@ -52,7 +52,7 @@ public:
             return nullptr;
         }
         auto ret = std::make_shared<Task>(std::move(task));
-        _queue.push_task(ret);
+        _queue.push_task(TaskNode::create([ret]() { (*ret)(); }));
         return ret;
     }
     Task::Ptr async_first(TaskIn task,bool may_sync = true) override{
@@ -62,14 +62,28 @@ public:
         }
 
         auto ret = std::make_shared<Task>(std::move(task));
-        _queue.push_task_first(ret);
+        _queue.push_task_first(TaskNode::create([ret]() { (*ret)(); }));
         return ret;
     }
 
+    //投递任务节点，列队本身不需要为任务分配内存
+    void postNode(TaskNode *node, bool may_sync) override {
+        if (may_sync && _thread_group.is_this_thread_in()) {
+            std::unique_ptr<TaskNode, void (*)(TaskNode *)> holder(node, TaskNode::recycle);
+            holder->run();
+            return;
+        }
+        _queue.push_task(node);
+    }
+
     size_t size(){
         return _queue.size();
     }
 
+    size_t taskCount() override {
+        return _queue.size();
+    }
+
     static bool setPriority(Priority priority = PRIORITY_NORMAL,
             thread::native_handle_type threadId = 0) {
         // set priority
@@ -113,17 +127,18 @@ public:
 private:
     void run() {
         ThreadPool::setPriority(_priority);
-        Task::Ptr task;
+        TaskNode *node;
         while (true) {
             startSleep();
-            if (!_queue.get_task(task)) {
+            if (!_queue.get_task(node)) {
                 //空任务，退出线程
                 break;
             }
             sleepWakeUp();
+            //即便抛异常也要回收节点
+            std::unique_ptr<TaskNode, void (*)(TaskNode *)> task(node, TaskNode::recycle);
             try {
-                (*task)();
-                task = nullptr;
+                task->run();
             } catch (std::exception &ex) {
                 ErrorL << "ThreadPool执行任务捕获到异常:" << ex.what();
             }
@@ -139,7 +154,7 @@ private:
     }
 private:
     size_t _thread_num;
-    TaskQueue<Task::Ptr> _queue;
+    TaskQueue<TaskNode *, TaskNodeList> _queue;
     thread_group _thread_group;
     Priority _priority;
     Logger::Ptr _logger;
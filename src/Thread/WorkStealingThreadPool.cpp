@@ -0,0 +1,258 @@
+﻿/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/xia-chu/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "WorkStealingThreadPool.h"
+
+namespace toolkit {
+
+//当前线程所属的线程池与工作线程序号，用于无锁判断任务应该压入哪个列队
+struct CurrentWorker {
+    const WorkStealingThreadPool *pool = nullptr;
+    size_t index = 0;
+};
+static thread_local CurrentWorker s_current_worker;
+
+//从列队顶部取出任务，与窃取者竞争失败时重试，直到取到任务或列队为空
+static bool takeTop(WorkStealingQueue<TaskNode *> &queue, TaskNode *&task) {
+    while (!queue.empty()) {
+        if (queue.steal(task)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+WorkStealingThreadPool::WorkStealingThreadPool(int num, ThreadPool::Priority priority, bool auto_run) {
+    _priority = priority;
+    _logger = Logger::Instance().shared_from_this();
+    num = num > 0 ? num : 1;
+    for (int i = 0; i < num; ++i) {
+        _workers.emplace_back(new Worker);
+        _workers.back()->seed = (i + 1) * 0x9E3779B97F4A7C15ULL;
+    }
+    if (auto_run) {
+        start();
+    }
+}
+
+WorkStealingThreadPool::~WorkStealingThreadPool() {
+    shutdown();
+    wait();
+    //回收尚未执行的任务，收件箱与first列表由其析构函数回收
+    TaskNode *task;
+    for (auto &worker : _workers) {
+        while (takeTop(worker->queue, task)) {
+            TaskNode::recycle(task);
+        }
+    }
+}
+
+Task::Ptr WorkStealingThreadPool::async(TaskIn task, bool may_sync) {
+    if (may_sync && isCurrentThread()) {
+        task();
+        return nullptr;
+    }
+    auto ret = std::make_shared<Task>(std::move(task));
+    pushTask(TaskNode::create([ret]() { (*ret)(); }), false);
+    return ret;
+}
+
+Task::Ptr WorkStealingThreadPool::async_first(TaskIn task, bool may_sync) {
+    if (may_sync && isCurrentThread()) {
+        task();
+        return nullptr;
+    }
+    auto ret = std::make_shared<Task>(std::move(task));
+    pushTask(TaskNode::create([ret]() { (*ret)(); }), true);
+    return ret;
+}
+
+void WorkStealingThreadPool::postNode(TaskNode *node, bool may_sync) {
+    if (may_sync && isCurrentThread()) {
+        std::unique_ptr<TaskNode, void (*)(TaskNode *)> holder(node, TaskNode::recycle);
+        holder->run();
+        return;
+    }
+    pushTask(node, false);
+}
+
+size_t WorkStealingThreadPool::taskCount() {
+    size_t ret = 0;
+    for (auto &worker : _workers) {
+        ret += worker->queue.size();
+    }
+    return ret;
+}
+
+bool WorkStealingThreadPool::isCurrentThread() const {
+    return s_current_worker.pool == this;
+}
+
+void WorkStealingThreadPool::start() {
+    if (_thread_group.size()) {
+        return;
+    }
+    for (size_t i = 0; i < _workers.size(); ++i) {
+        _thread_group.create_thread(bind(&WorkStealingThreadPool::run, this, i));
+    }
+}
+
+void WorkStealingThreadPool::pushTask(TaskNode *task, bool first) {
+    if (isCurrentThread()) {
+        auto &worker = *_workers[s_current_worker.index];
+        if (first) {
+            //只有本线程访问，本线程下一个执行
+            worker.first.emplace_front(task);
+            return;
+        }
+        //内部线程，压入本线程的列队底部，空闲线程可以窃取
+        worker.queue.push(task);
+        wakeupIdle();
+        return;
+    }
+    auto &worker = *_workers[_next_worker.fetch_add(1, memory_order_relaxed) % _workers.size()];
+    if (first) {
+        worker.inbox_first.push(task);
+    } else {
+        worker.inbox.push(task);
+    }
+    //收件箱只能由其拥有者消费，所以必须唤醒该线程
+    wakeupWorker(worker);
+}
+
+void WorkStealingThreadPool::wakeupWorker(Worker &worker) {
+    //与waitTask中置位sleeping后重新检查列队构成Dekker同步，保证不会丢失唤醒
+    atomic_thread_fence(memory_order_seq_cst);
+    if (worker.sleeping.load(memory_order_relaxed) && worker.sleeping.exchange(false)) {
+        worker.sem.post();
+    }
+}
+
+void WorkStealingThreadPool::wakeupIdle() {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (!_idle_count.load(memory_order_relaxed)) {
+        return;
+    }
+    //唤醒任意一个休眠的线程，由其窃取任务
+    for (auto &worker : _workers) {
+        if (worker->sleeping.load(memory_order_relaxed) && worker->sleeping.exchange(false)) {
+            worker->sem.post();
+            return;
+        }
+    }
+}
+
+bool WorkStealingThreadPool::getTask(size_t index, TaskNode *&task) {
+    auto &worker = *_workers[index];
+    if (!worker.inbox_first.empty()) {
+        //逐个插入头部，后投递的先执行
+        worker.inbox_first.take([&](TaskNode *item) {
+            worker.first.emplace_front(item);
+        });
+    }
+    if (worker.first.size()) {
+        task = worker.first.front();
+        worker.first.pop_front();
+        return true;
+    }
+    if (takeTop(worker.queue, task)) {
+        return true;
+    }
+    //把收件箱中的任务按投递顺序转移至本线程的列队，这样其他线程可以窃取
+    auto count = worker.inbox.take([&](TaskNode *item) {
+        worker.queue.push(item);
+    });
+    if (count > 1) {
+        wakeupIdle();
+    }
+    if (takeTop(worker.queue, task)) {
+        return true;
+    }
+    return stealTask(index, task);
+}
+
+bool WorkStealingThreadPool::stealTask(size_t index, TaskNode *&task) {
+    auto size = _workers.size();
+    if (size < 2) {
+        return false;
+    }
+    auto &seed = _workers[index]->seed;
+    //xorshift随机选择起始窃取对象
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    auto start = seed % size;
+    for (size_t i = 0; i < size; ++i) {
+        auto victim = (start + i) % size;
+        if (victim != index && _workers[victim]->queue.steal(task)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool WorkStealingThreadPool::waitTask(size_t index, TaskNode *&task) {
+    auto &worker = *_workers[index];
+    while (true) {
+        worker.sleeping.store(true);
+        _idle_count.fetch_add(1);
+        //置位休眠标记后必须重新检查一遍，防止丢失唤醒
+        auto got = getTask(index, task);
+        if (got || _exit_flag.load()) {
+            _idle_count.fetch_sub(1);
+            if (!worker.sleeping.exchange(false)) {
+                //已经有线程唤醒了本线程，消耗掉该信号
+                worker.sem.wait();
+            }
+            return got;
+        }
+        worker.sem.wait();
+        _idle_count.fetch_sub(1);
+    }
+}
+
+void WorkStealingThreadPool::run(size_t index) {
+    s_current_worker.pool = this;
+    s_current_worker.index = index;
+    ThreadPool::setPriority(_priority);
+    TaskNode *node;
+    while (true) {
+        if (!getTask(index, node)) {
+            startSleep();
+            auto got = waitTask(index, node);
+            sleepWakeUp();
+            if (!got) {
+                //线程池已经关闭且没有剩余任务，退出线程
+                break;
+            }
+        }
+        //即便抛异常也要回收节点
+        std::unique_ptr<TaskNode, void (*)(TaskNode *)> task(node, TaskNode::recycle);
+        try {
+            task->run();
+        } catch (std::exception &ex) {
+            ErrorL << "WorkStealingThreadPool执行任务捕获到异常:" << ex.what();
+        }
+    }
+    s_current_worker.pool = nullptr;
+}
+
+void WorkStealingThreadPool::shutdown() {
+    _exit_flag = true;
+    for (auto &worker : _workers) {
+        wakeupWorker(*worker);
+    }
+}
+
+void WorkStealingThreadPool::wait() {
+    _thread_group.join_all();
+}
+
+} /* namespace toolkit */
@@ -0,0 +1,122 @@
+﻿/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/xia-chu/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLTOOLKIT_WORKSTEALINGTHREADPOOL_H
+#define ZLTOOLKIT_WORKSTEALINGTHREADPOOL_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "ThreadPool.h"
+#include "threadgroup.h"
+#include "semaphore.h"
+#include "TaskNode.h"
+#include "TaskExecutor.h"
+#include "Util/WorkStealingQueue.h"
+using namespace std;
+
+namespace toolkit {
+
+/**
+ * 工作窃取线程池
+ * 每个工作线程拥有一个无锁双端列队，线程池内部线程投递的任务直接压入本线程的列队底部，不需要加锁；
+ * 外部线程投递的任务轮流投递到各工作线程的无锁收件箱，由工作线程转移至自己的列队；
+ * 工作线程从自己列队的顶部取出任务，所以同一线程投递的任务与ThreadPool一样按投递顺序执行；
+ * 工作线程空闲时随机选择其他线程，同样从其列队顶部窃取任务执行，被窃取的任务可能与后续任务并行执行
+ * 任务以侵入式任务节点存放，列队与收件箱本身不需要为任务分配内存
+ */
+class WorkStealingThreadPool : public TaskExecutor {
+public:
+    typedef std::shared_ptr<WorkStealingThreadPool> Ptr;
+
+    /**
+     * 构造函数
+     * @param num 线程个数
+     * @param priority 线程优先级
+     * @param auto_run 是否立即启动线程，否则需要调用start
+     */
+    WorkStealingThreadPool(int num = 1,
+                           ThreadPool::Priority priority = ThreadPool::PRIORITY_HIGHEST,
+                           bool auto_run = true);
+    ~WorkStealingThreadPool();
+
+    /**
+     * 把任务打入线程池并异步执行
+     * @param task 任务
+     * @param may_sync 调用线程为本线程池的线程时，是否同步执行
+     */
+    Task::Ptr async(TaskIn task, bool may_sync = true) override;
+
+    /**
+     * 同async，任务优先于所投递线程中的普通任务执行，且不会被窃取；后投递的先执行，与ThreadPool一致
+     */
+    Task::Ptr async_first(TaskIn task, bool may_sync = true) override;
+
+    /**
+     * 投递任务节点，节点直接压入列队或收件箱，不需要任何内存分配
+     */
+    void postNode(TaskNode *node, bool may_sync) override;
+
+    /**
+     * 启动线程
+     */
+    void start();
+
+    /**
+     * 获取各线程列队中尚未执行的任务个数，不包括尚未转移的收件箱中的任务
+     */
+    size_t taskCount() override;
+
+    /**
+     * 判断调用线程是否为本线程池的线程
+     */
+    bool isCurrentThread() const;
+
+private:
+    struct Worker {
+        //本线程的任务列队，本线程与窃取者都从顶部取出
+        WorkStealingQueue<TaskNode *> queue;
+        //async_first投递的任务，只在本线程访问，不可窃取
+        TaskNodeList first;
+        //外部线程投递的任务
+        TaskNodeStack inbox;
+        //外部线程通过async_first投递的任务
+        TaskNodeStack inbox_first;
+        //是否处于休眠状态，唤醒者负责复位
+        atomic<bool> sleeping{false};
+        semaphore sem;
+        //随机选择窃取对象用
+        uint64_t seed;
+    };
+
+    void run(size_t index);
+    void pushTask(TaskNode *task, bool first);
+    bool getTask(size_t index, TaskNode *&task);
+    bool stealTask(size_t index, TaskNode *&task);
+    bool waitTask(size_t index, TaskNode *&task);
+    void wakeupWorker(Worker &worker);
+    void wakeupIdle();
+    void shutdown();
+    void wait();
+
+private:
+    ThreadPool::Priority _priority;
+    atomic<bool> _exit_flag{false};
+    //处于休眠状态的线程个数，用于判断是否需要唤醒
+    atomic<size_t> _idle_count{0};
+    //外部线程轮流投递任务的位置
+    atomic<size_t> _next_worker{0};
+    vector<std::unique_ptr<Worker> > _workers;
+    thread_group _thread_group;
+    Logger::Ptr _logger;
+};
+
+} /* namespace toolkit */
+#endif //ZLTOOLKIT_WORKSTEALINGTHREADPOOL_H
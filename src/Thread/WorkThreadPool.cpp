@@ -16,6 +16,7 @@
 namespace toolkit {
 
 int WorkThreadPool::s_pool_size = 0;
+bool WorkThreadPool::s_work_stealing = false;
 
 INSTANCE_IMP(WorkThreadPool);
 
@@ -24,7 +25,14 @@ EventPoller::Ptr WorkThreadPool::getFirstPoller(){
 }
 
 EventPoller::Ptr WorkThreadPool::getPoller(){
-    return dynamic_pointer_cast<EventPoller>(getExecutor());
+    return dynamic_pointer_cast<EventPoller>(TaskExecutorGetterImp::getExecutor());
+}
+
+TaskExecutor::Ptr WorkThreadPool::getExecutor(){
+    if (_stealing_pool) {
+        return _stealing_pool;
+    }
+    return TaskExecutorGetterImp::getExecutor();
 }
 
 WorkThreadPool::WorkThreadPool(){
@@ -35,11 +43,18 @@ WorkThreadPool::WorkThreadPool(){
         ret->runLoop(false, false);
         return ret;
     },size);
+    if (s_work_stealing) {
+        _stealing_pool = std::make_shared<WorkStealingThreadPool>(size, ThreadPool::PRIORITY_LOWEST);
+    }
 }
 
 void WorkThreadPool::setPoolSize(int size) {
     s_pool_size = size;
 }
 
+void WorkThreadPool::enableWorkStealing(bool enable) {
+    s_work_stealing = enable;
+}
+
 } /* namespace toolkit */
 
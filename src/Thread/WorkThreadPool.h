@@ -13,6 +13,7 @@
 
 #include <memory>
 #include "ThreadPool.h"
+#include "WorkStealingThreadPool.h"
 #include "Poller/EventPoller.h"
 using namespace std;
 
@@ -38,6 +39,20 @@ public:
      */
     static void setPoolSize(int size = 0);
 
+    /**
+     * 设置getExecutor是否返回工作窃取线程池，在WorkThreadPool单例创建前有效
+     * 开启后额外创建一个线程个数与EventPoller个数相同的WorkStealingThreadPool，
+     * getExecutor投递的阻塞式任务(dns解析、数据库操作等)由空闲线程互相窃取执行，不会因某个线程被长任务阻塞而积压；
+     * getPoller与getFirstPoller仍然返回EventPoller，用于需要定时器或网络事件的场景
+     * @param enable 是否开启
+     */
+    static void enableWorkStealing(bool enable = true);
+
+    /**
+     * 获取任务执行器，开启工作窃取时返回工作窃取线程池，否则根据负载情况获取EventPoller
+     */
+    TaskExecutor::Ptr getExecutor() override;
+
     /**
      * 获取第一个实例
      * @return
@@ -55,6 +70,8 @@ private:
     WorkThreadPool() ;
 private:
     static int s_pool_size;
+    static bool s_work_stealing;
+    WorkStealingThreadPool::Ptr _stealing_pool;
 };
 
 } /* namespace toolkit */
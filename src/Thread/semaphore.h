@@ -13,14 +13,21 @@
 
 /*
  * 目前发现信号量在32位的系统上有问题，
- * 休眠的线程无法被正常唤醒，先禁用之
- #if defined(__linux__)
-#include <semaphore.h>
-#define HAVE_SEM
-#endif //HAVE_SEM
-*/
+ * 休眠的线程无法被正常唤醒，故不使用sem_t；
+ * linux下直接基于futex实现，其他平台使用条件变量
+ */
+#if defined(__linux__)
+#include <unistd.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#define HAS_FUTEX
+#endif //__linux__
+
 #include <atomic>
 #include <mutex>
+#include <thread>
+#include <algorithm>
 #include <condition_variable>
 using namespace std;
 
@@ -29,21 +36,23 @@ namespace toolkit {
 class semaphore {
 public:
     explicit semaphore(size_t initial = 0) {
-#if defined(HAVE_SEM)
-        sem_init(&_sem, 0, initial);
+#if defined(HAS_FUTEX)
+        _count.store((int) initial, memory_order_relaxed);
 #else
-        _count = 0;
-#endif
-    }
-    ~semaphore() {
-#if defined(HAVE_SEM)
-        sem_destroy(&_sem);
+        _count = initial;
 #endif
     }
+    ~semaphore() {}
+
     void post(size_t n = 1) {
-#if defined(HAVE_SEM)
-        while (n--) {
-            sem_post(&_sem);
+#if defined(HAS_FUTEX)
+        //一次原子加即可增加n个计数，计数为负时代表有线程已经或即将休眠
+        auto count = _count.fetch_add((int) n, memory_order_release);
+        if (count < 0) {
+            //只唤醒需要的线程个数；没有线程休眠时不需要系统调用
+            auto wake = std::min(-count, (int) n);
+            _wakeups.fetch_add(wake, memory_order_release);
+            futex(FUTEX_WAKE_PRIVATE, wake);
         }
 #else
         unique_lock<mutex> lock(_mutex);
@@ -54,11 +63,33 @@ public:
             _condition.notify_all();
         }
 #endif
-
     }
+
     void wait() {
-#if defined(HAVE_SEM)
-        sem_wait(&_sem);
+#if defined(HAS_FUTEX)
+        //先自旋一小段时间，在计数很快被post的场景下避免休眠与唤醒的系统调用
+        for (int i = 0; i < spinCount(); ++i) {
+            auto count = _count.load(memory_order_relaxed);
+            if (count > 0 && _count.compare_exchange_weak(count, count - 1, memory_order_acquire, memory_order_relaxed)) {
+                return;
+            }
+            cpuRelax();
+        }
+        if (_count.fetch_sub(1, memory_order_acquire) > 0) {
+            return;
+        }
+        //计数不足，已登记为等待者，等待post分配唤醒名额
+        while (true) {
+            auto wakeups = _wakeups.load(memory_order_relaxed);
+            if (wakeups > 0) {
+                if (_wakeups.compare_exchange_weak(wakeups, wakeups - 1, memory_order_acquire, memory_order_relaxed)) {
+                    return;
+                }
+                continue;
+            }
+            //唤醒名额为0时才休眠，内核会原子的检查该条件，所以不会丢失唤醒
+            futex(FUTEX_WAIT_PRIVATE, 0);
+        }
 #else
         unique_lock<mutex> lock(_mutex);
         while (_count == 0) {
@@ -67,9 +98,34 @@ public:
         --_count;
 #endif
     }
+
+private:
+#if defined(HAS_FUTEX)
+    long futex(int op, int val) {
+        return syscall(SYS_futex, reinterpret_cast<int *>(&_wakeups), op, val, nullptr, nullptr, 0);
+    }
+
+    static int spinCount() {
+        //单核时自旋没有意义
+        static int s_spin = thread::hardware_concurrency() > 1 ? 100 : 0;
+        return s_spin;
+    }
+
+    static void cpuRelax() {
+#if defined(__i386__) || defined(__x86_64__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+        asm volatile("yield");
+#endif
+    }
+#endif //HAS_FUTEX
+
 private:
-#if defined(HAVE_SEM)
-    sem_t _sem;
+#if defined(HAS_FUTEX)
+    //剩余计数，为负数时其绝对值为等待者个数
+    atomic<int> _count;
+    //post分配给等待者的唤醒名额，同时也是futex的等待地址
+    atomic<int> _wakeups{0};
 #else
     size_t _count;
     mutex _mutex;
@@ -0,0 +1,205 @@
+﻿/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/xia-chu/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLTOOLKIT_MPSCQUEUE_H
+#define ZLTOOLKIT_MPSCQUEUE_H
+
+#include <atomic>
+#include <thread>
+#include <utility>
+using namespace std;
+
+namespace toolkit {
+
+/**
+ * 侵入式无锁多生产者单消费者列队(Dmitry Vyukov算法)
+ * 生产者入列只需要一次原子交换，任意线程均可调用push；pop/consume只能由同一个消费者线程调用
+ * 最后一个出列的节点作为哨兵节点留在列队中，下次出列时才回收，所以出列节点在下次出列前一直有效
+ * @tparam NODE 节点类型
+ * @tparam POLICY 节点策略，需要提供以下静态函数：
+ *         NODE *obtain()：获取一个节点，用作初始哨兵节点
+ *         void recycle(NODE *)：回收节点
+ *         atomic<NODE *> &next(NODE *)：节点的链接指针
+ */
+template<typename NODE, typename POLICY>
+class IntrusiveMPSCQueue {
+public:
+    IntrusiveMPSCQueue() {
+        _tail = POLICY::obtain();
+        _head.store(_tail, memory_order_relaxed);
+    }
+
+    ~IntrusiveMPSCQueue() {
+        while (_tail) {
+            auto next = POLICY::next(_tail).load(memory_order_relaxed);
+            POLICY::recycle(_tail);
+            _tail = next;
+        }
+    }
+
+    IntrusiveMPSCQueue(const IntrusiveMPSCQueue &that) = delete;
+    IntrusiveMPSCQueue &operator=(const IntrusiveMPSCQueue &that) = delete;
+
+    /**
+     * 入列，可以在任意线程调用
+     */
+    void push(NODE *node) {
+        POLICY::next(node).store(nullptr, memory_order_relaxed);
+        //使用seq_cst，保证与调用者随后的唤醒标记操作之间的顺序
+        auto prev = _head.exchange(node);
+        //此处到下一句之间，消费者会看到一个尚未连接的节点，见waitNext
+        POLICY::next(prev).store(node, memory_order_release);
+    }
+
+    /**
+     * 出列，只能在消费者线程调用
+     * @return 出列的节点，该节点成为新的哨兵节点，由列队负责回收；列队为空时返回nullptr
+     */
+    NODE *pop() {
+        auto next = waitNext(_tail);
+        if (!next) {
+            return nullptr;
+        }
+        POLICY::recycle(_tail);
+        _tail = next;
+        return next;
+    }
+
+    /**
+     * 消费调用本函数时列队中已有的所有节点，之后入列的节点留待下次消费
+     * 只能在消费者线程调用
+     * @param func 消费函数，参数为NODE &，节点由列队负责回收
+     * @return 消费的节点个数
+     */
+    template<typename FUNC>
+    size_t consume(FUNC &&func) {
+        auto last = _head.load();
+        size_t count = 0;
+        while (_tail != last) {
+            auto next = waitNext(_tail);
+            POLICY::recycle(_tail);
+            _tail = next;
+            ++count;
+            func(*next);
+        }
+        return count;
+    }
+
+    /**
+     * 列队是否为空，只能在消费者线程调用
+     */
+    bool empty() const {
+        return _tail == _head.load();
+    }
+
+private:
+    NODE *waitNext(NODE *node) {
+        auto next = POLICY::next(node).load(memory_order_acquire);
+        while (!next && node != _head.load(memory_order_acquire)) {
+            //生产者已经交换了头节点但是尚未连接，该窗口极短，让出cpu等待即可
+            this_thread::yield();
+            next = POLICY::next(node).load(memory_order_acquire);
+        }
+        return next;
+    }
+
+private:
+    //生产者入列的位置
+    atomic<NODE *> _head;
+    //消费者出列的位置，始终指向哨兵节点
+    NODE *_tail;
+};
+
+/**
+ * 无锁多生产者单消费者列队，每个元素在堆上分配一个节点
+ * pop/consume只能由同一个消费者线程调用
+ * @tparam T 元素类型，必须可以默认构造
+ */
+template<typename T>
+class MPSCQueue {
+public:
+    MPSCQueue() = default;
+    MPSCQueue(const MPSCQueue &that) = delete;
+    MPSCQueue &operator=(const MPSCQueue &that) = delete;
+
+    /**
+     * 入列，可以在任意线程调用
+     */
+    template<class... Args>
+    void push(Args &&...args) {
+        _queue.push(new Node(std::forward<Args>(args)...));
+    }
+
+    /**
+     * 出列，只能在消费者线程调用
+     * @param value 出列的元素
+     * @return 列队为空时返回false
+     */
+    bool pop(T &value) {
+        auto node = _queue.pop();
+        if (!node) {
+            return false;
+        }
+        value = std::move(node->value);
+        return true;
+    }
+
+    /**
+     * 消费调用本函数时列队中已有的所有元素，之后入列的元素留待下次消费
+     * 只能在消费者线程调用
+     * @param func 消费函数，参数为T &
+     * @return 消费的元素个数
+     */
+    template<typename FUNC>
+    size_t consume(FUNC &&func) {
+        return _queue.consume([&](Node &node) {
+            T value = std::move(node.value);
+            func(value);
+        });
+    }
+
+    /**
+     * 列队是否为空，只能在消费者线程调用
+     */
+    bool empty() const {
+        return _queue.empty();
+    }
+
+private:
+    struct Node {
+        Node() = default;
+
+        template<class... Args>
+        Node(Args &&...args) : value(std::forward<Args>(args)...) {}
+
+        atomic<Node *> next{nullptr};
+        T value;
+    };
+
+    struct Policy {
+        static Node *obtain() {
+            return new Node;
+        }
+
+        static void recycle(Node *node) {
+            delete node;
+        }
+
+        static atomic<Node *> &next(Node *node) {
+            return node->next;
+        }
+    };
+
+private:
+    IntrusiveMPSCQueue<Node, Policy> _queue;
+};
+
+} /* namespace toolkit */
+#endif //ZLTOOLKIT_MPSCQUEUE_H
@@ -0,0 +1,155 @@
+﻿/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/xia-chu/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLTOOLKIT_WORKSTEALINGQUEUE_H
+#define ZLTOOLKIT_WORKSTEALINGQUEUE_H
+
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+using namespace std;
+
+namespace toolkit {
+
+/**
+ * 无锁工作窃取双端列队(Chase-Lev算法，内存序参考Lê等人的弱内存模型版本)
+ * 拥有者线程在底部push/pop，不需要任何锁；其他线程可以并发的从顶部steal
+ * 列队满时自动扩容，旧的数组在列队析构时才释放，以免窃取者访问到已释放的内存
+ * @tparam T 元素类型，必须是指针等可以原子读写的类型
+ */
+template<typename T>
+class WorkStealingQueue {
+public:
+    /**
+     * @param capacity 初始容量，必须为2的幂
+     */
+    explicit WorkStealingQueue(size_t capacity = 1024) {
+        _array.store(new Array(capacity), memory_order_relaxed);
+    }
+
+    ~WorkStealingQueue() {
+        delete _array.load(memory_order_relaxed);
+        for (auto array : _garbage) {
+            delete array;
+        }
+    }
+
+    WorkStealingQueue(const WorkStealingQueue &that) = delete;
+    WorkStealingQueue &operator=(const WorkStealingQueue &that) = delete;
+
+    /**
+     * 在底部入列，只能在拥有者线程调用
+     */
+    void push(T value) {
+        auto b = _bottom.load(memory_order_relaxed);
+        auto t = _top.load(memory_order_acquire);
+        auto array = _array.load(memory_order_relaxed);
+        if (b - t > (int64_t) array->mask) {
+            array = grow(array, t, b);
+        }
+        array->put(b, value);
+        atomic_thread_fence(memory_order_release);
+        _bottom.store(b + 1, memory_order_relaxed);
+    }
+
+    /**
+     * 从底部出列(后进先出)，只能在拥有者线程调用
+     * @return 列队为空时返回false
+     */
+    bool pop(T &value) {
+        auto b = _bottom.load(memory_order_relaxed) - 1;
+        auto array = _array.load(memory_order_relaxed);
+        _bottom.store(b, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        auto t = _top.load(memory_order_relaxed);
+        if (t > b) {
+            //列队为空
+            _bottom.store(b + 1, memory_order_relaxed);
+            return false;
+        }
+        value = array->get(b);
+        if (t == b) {
+            //最后一个元素，需要与窃取者竞争
+            bool success = _top.compare_exchange_strong(t, t + 1, memory_order_seq_cst, memory_order_relaxed);
+            _bottom.store(b + 1, memory_order_relaxed);
+            return success;
+        }
+        return true;
+    }
+
+    /**
+     * 从顶部窃取(先进先出)，可以在任意线程调用
+     * @return 列队为空或与其他线程竞争失败时返回false
+     */
+    bool steal(T &value) {
+        auto t = _top.load(memory_order_acquire);
+        atomic_thread_fence(memory_order_seq_cst);
+        auto b = _bottom.load(memory_order_acquire);
+        if (t >= b) {
+            return false;
+        }
+        auto array = _array.load(memory_order_acquire);
+        value = array->get(t);
+        return _top.compare_exchange_strong(t, t + 1, memory_order_seq_cst, memory_order_relaxed);
+    }
+
+    /**
+     * 元素个数，其他线程调用时仅为近似值
+     */
+    size_t size() const {
+        auto b = _bottom.load(memory_order_relaxed);
+        auto t = _top.load(memory_order_relaxed);
+        return b > t ? (size_t) (b - t) : 0;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+private:
+    struct Array {
+        explicit Array(size_t capacity) : mask(capacity - 1), buffer(new atomic<T>[capacity]) {}
+
+        ~Array() {
+            delete[] buffer;
+        }
+
+        void put(int64_t index, T value) {
+            buffer[index & mask].store(value, memory_order_relaxed);
+        }
+
+        T get(int64_t index) const {
+            return buffer[index & mask].load(memory_order_relaxed);
+        }
+
+        size_t mask;
+        atomic<T> *buffer;
+    };
+
+    Array *grow(Array *array, int64_t top, int64_t bottom) {
+        auto ret = new Array((array->mask + 1) * 2);
+        for (auto i = top; i < bottom; ++i) {
+            ret->put(i, array->get(i));
+        }
+        _garbage.emplace_back(array);
+        _array.store(ret, memory_order_release);
+        return ret;
+    }
+
+private:
+    atomic<int64_t> _top{0};
+    atomic<int64_t> _bottom{0};
+    atomic<Array *> _array;
+    //扩容前的数组，只在拥有者线程访问
+    vector<Array *> _garbage;
+};
+
+} /* namespace toolkit */
+#endif //ZLTOOLKIT_WORKSTEALINGQUEUE_H
@@ -21,6 +21,12 @@
 #include "Util/uv_errno.h"
 #include "Network/sockutil.h"
 
+#if defined(__linux__)
+#include <sched.h>
+#include <dirent.h>
+#include <pthread.h>
+#endif //defined(__linux__)
+
 #if defined(_WIN32)
 #include <shlwapi.h>  
 #pragma comment(lib, "shlwapi.lib")
@@ -404,6 +410,70 @@ struct tm getLocalTime(time_t sec) {
     return tm;
 }
 
+//当前线程绑定的numa节点
+static thread_local int s_thread_numa_node = 0;
+
+vector<int> getAvailableCpus() {
+    vector<int> ret;
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                ret.emplace_back(cpu);
+            }
+        }
+    }
+#endif //defined(__linux__)
+    if (ret.empty()) {
+        for (int cpu = 0; cpu < (int) thread::hardware_concurrency(); ++cpu) {
+            ret.emplace_back(cpu);
+        }
+    }
+    return ret;
+}
 
-}  // namespace toolkit
+bool setThreadAffinity(int cpu) {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        return false;
+    }
+    s_thread_numa_node = getCpuNumaNode(cpu);
+    return true;
+#elif defined(_WIN32)
+    return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR) 1 << cpu) != 0;
+#else
+    //macOS等平台不支持绑定cpu核心
+    return false;
+#endif
+}
 
+int getCpuNumaNode(int cpu) {
+    int ret = 0;
+#if defined(__linux__)
+    //cpu所属的numa节点在sysfs中以nodeN目录的形式存在
+    auto dir = opendir(("/sys/devices/system/cpu/cpu" + to_string(cpu)).data());
+    if (!dir) {
+        return 0;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        if (strncmp(entry->d_name, "node", 4) == 0 && isdigit(entry->d_name[4])) {
+            ret = atoi(entry->d_name + 4);
+            break;
+        }
+    }
+    closedir(dir);
+#endif //defined(__linux__)
+    return ret;
+}
+
+int getThreadNumaNode() {
+    return s_thread_numa_node;
+}
+
+}  // namespace toolkit
@@ -259,5 +259,29 @@ string getTimeStr(const char *fmt,time_t time = 0);
  */
 struct tm getLocalTime(time_t sec);
 
+/**
+ * 获取当前进程允许运行的cpu核心编号列表
+ */
+vector<int> getAvailableCpus();
+
+/**
+ * 绑定当前线程至指定cpu核心，并记录该核心所属的numa节点
+ * @param cpu cpu核心编号
+ * @return 是否绑定成功
+ */
+bool setThreadAffinity(int cpu);
+
+/**
+ * 获取cpu核心所属的numa节点编号
+ * @param cpu cpu核心编号
+ * @return numa节点编号，不支持numa或获取失败时返回0
+ */
+int getCpuNumaNode(int cpu);
+
+/**
+ * 获取当前线程通过setThreadAffinity绑定的numa节点编号，未绑定时返回0
+ */
+int getThreadNumaNode();
+
 }  // namespace toolkit
 #endif /* UTIL_UTIL_H_ */
@@ -0,0 +1,111 @@
+﻿/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/xia-chu/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <signal.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <iostream>
+#include "Util/logger.h"
+#include "Util/TimeTicker.h"
+#include "Network/TcpServer.h"
+#include "Network/sockutil.h"
+
+using namespace std;
+using namespace toolkit;
+
+static atomic<uint64_t> s_accepted{0};
+
+class AcceptSession : public TcpSession {
+public:
+    AcceptSession(const Socket::Ptr &sock) : TcpSession(sock) {
+        ++s_accepted;
+    }
+
+    void attachServer(const Server &/*server*/) override {
+        //连接建立后立即由服务器关闭，防止poller繁忙时客户端的关闭来不及处理导致fd耗尽
+        weak_ptr<Session> weak_self = shared_from_this();
+        getPoller()->async([weak_self]() {
+            if (auto strong_self = weak_self.lock()) {
+                strong_self->shutdown();
+            }
+        }, false);
+    }
+
+    void onRecv(const Buffer::Ptr &/*buf*/) override {}
+
+    void onError(const SockException &/*err*/) override {}
+
+    void onManager() override {}
+};
+
+/**
+ * 测试tcp服务器每秒可接收的连接数
+ * 客户端线程循环执行阻塞connect与close
+ * 用法: test_acceptBenchmark [shared|reuseport] [秒数] [客户端线程数] [poller个数]
+ * shared: 所有poller共享同一个listen fd(EPOLLEXCLUSIVE)
+ * reuseport: 每个poller独立绑定一个SO_REUSEPORT socket
+ */
+int main(int argc, char *argv[]) {
+    signal(SIGINT, [](int) {
+        exit(0);
+    });
+    //初始化日志系统
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+    Logger::Instance().setLevel(LWarn);
+
+    bool reuse_port = argc > 1 && string(argv[1]) == "reuseport";
+    int seconds = argc > 2 ? atoi(argv[2]) : 5;
+    int client_count = argc > 3 ? atoi(argv[3]) : 4;
+    int poller_count = argc > 4 ? atoi(argv[4]) : 0;
+    EventPollerPool::setPoolSize(poller_count);
+
+    auto server = std::make_shared<TcpServer>();
+    server->setReusePort(reuse_port);
+    server->start<AcceptSession>(0, "127.0.0.1");
+    auto port = server->getPort();
+
+    atomic<bool> exit_flag{false};
+    atomic<uint64_t> connect_failed{0};
+    vector<thread> clients;
+    for (int i = 0; i < client_count; ++i) {
+        clients.emplace_back([&]() {
+            while (!exit_flag) {
+                int fd = SockUtil::connect("127.0.0.1", port, false);
+                if (fd == -1) {
+                    ++connect_failed;
+                    continue;
+                }
+                //以RST立即关闭，避免大量TIME_WAIT占用本地端口
+                struct linger lg = {1, 0};
+                setsockopt(fd, SOL_SOCKET, SO_LINGER, (char *) &lg, sizeof(lg));
+                close(fd);
+            }
+        });
+    }
+
+    Ticker ticker;
+    for (int i = 0; i < seconds; ++i) {
+        auto last = s_accepted.load();
+        sleep(1);
+        cout << "accept: " << s_accepted.load() - last << " conn/s" << endl;
+    }
+    exit_flag = true;
+    for (auto &th : clients) {
+        th.join();
+    }
+    auto ms = ticker.elapsedTime();
+    cout << (reuse_port ? "reuseport" : "shared") << " 共接收连接:" << s_accepted.load()
+         << " 平均:" << s_accepted.load() * 1000 / (ms ? ms : 1) << " conn/s"
+         << " 连接失败:" << connect_failed.load() << endl;
+    //等待已完成握手的连接被accept完毕再销毁服务器
+    sleep(1);
+    return 0;
+}
@@ -0,0 +1,96 @@
+﻿/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/xia-chu/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <signal.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <iostream>
+#include "Util/logger.h"
+#include "Util/TimeTicker.h"
+#include "Poller/EventPoller.h"
+#include "Thread/ThreadPool.h"
+#include "Thread/semaphore.h"
+#include "Thread/TaskNode.h"
+
+using namespace std;
+using namespace toolkit;
+
+/**
+ * 多个生产者线程同时向执行器投递任务，统计全部执行完毕的耗时
+ * 生产者与执行器不在同一线程，同时统计跨线程投递期间从堆上新分配的任务节点个数
+ * @param name 执行器名称
+ * @param executor 执行任务的执行器
+ * @param use_post 使用post还是async投递任务
+ * @param producer 生产者线程数
+ * @param total 任务总数
+ */
+static void benchmark(const char *name, const TaskExecutor::Ptr &executor, bool use_post, int producer, int total) {
+    atomic<int> count(0);
+    semaphore sem;
+    int per_producer = total / producer;
+    int expect = per_producer * producer;
+
+    auto heap_count = TaskNode::getHeapCount();
+    Ticker ticker;
+    auto begin_us = getCurrentMicrosecond();
+    vector<thread> threads;
+    for (int i = 0; i < producer; ++i) {
+        threads.emplace_back([&]() {
+            for (int j = 0; j < per_producer; ++j) {
+                auto task = [&count, &sem, expect]() {
+                    if (++count == expect) {
+                        sem.post();
+                    }
+                };
+                if (use_post) {
+                    executor->post(task, false);
+                } else {
+                    executor->async(task, false);
+                }
+            }
+        });
+    }
+    for (auto &th : threads) {
+        th.join();
+    }
+    auto enqueue_ms = ticker.elapsedTime();
+    sem.wait();
+    auto total_ms = ticker.elapsedTime();
+    auto total_ns = (getCurrentMicrosecond() - begin_us) * 1000;
+    InfoL << name << " " << (use_post ? "post " : "async") << " " << producer << "个生产者线程, " << expect << "个任务, 入队耗时:" << enqueue_ms
+          << "ms, 总耗时:" << total_ms << "ms, 每秒执行任务数:" << (total_ms ? expect * 1000LL / total_ms : expect)
+          << ", 每个任务耗时:" << total_ns / expect << "ns, 新分配节点数:" << TaskNode::getHeapCount() - heap_count;
+}
+
+/**
+ * 跨线程async与post吞吐量测试，分别测试EventPoller与ThreadPool
+ * 用法: test_asyncBenchmark [最大生产者线程数] [每轮任务总数]
+ */
+int main(int argc, char *argv[]) {
+    signal(SIGINT, [](int) {
+        exit(0);
+    });
+    //初始化日志系统
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+
+    int max_producer = argc > 1 ? atoi(argv[1]) : max(4, (int) thread::hardware_concurrency());
+    int total = argc > 2 ? atoi(argv[2]) : 1000 * 1000;
+
+    TaskExecutor::Ptr poller = EventPollerPool::Instance().getPoller();
+    TaskExecutor::Ptr pool = std::make_shared<ThreadPool>(1, ThreadPool::PRIORITY_HIGHEST);
+    for (int producer = 1; producer <= max_producer; ++producer) {
+        benchmark("EventPoller", poller, false, producer, total);
+        benchmark("EventPoller", poller, true, producer, total);
+        benchmark("ThreadPool", pool, false, producer, total);
+        benchmark("ThreadPool", pool, true, producer, total);
+    }
+    return 0;
+}
@@ -0,0 +1,173 @@
+﻿/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/xia-chu/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <signal.h>
+#include <atomic>
+#include <iostream>
+#include "Thread/semaphore.h"
+#include "Util/logger.h"
+#include "Network/Socket.h"
+
+using namespace std;
+using namespace toolkit;
+
+//发送缓存高低水位
+static constexpr size_t kHighWatermark = 256 * 1024;
+static constexpr size_t kLowWatermark = 64 * 1024;
+//每次发送的数据块大小
+static constexpr size_t kChunkSize = 16 * 1024;
+
+//等待条件成立
+template<typename FUNC>
+static bool waitFor(FUNC &&func) {
+    for (int i = 0; i < 300 && !func(); ++i) {
+        usleep(10 * 1000);
+    }
+    return func();
+}
+
+//确认一段时间内没有收到新的数据包
+static bool noMorePackets(const atomic<int> &received, int expect) {
+    usleep(100 * 1000);
+    return received == expect;
+}
+
+/**
+ * 下游socket发送缓存达到高水位时暂停上游socket的接收，降到低水位时恢复；
+ * 使用者在背压期间自己暂停的接收，不能因为水位回落而被恢复
+ */
+static bool testBackpressure() {
+    auto poller = EventPollerPool::Instance().getPoller();
+
+    //上游为udp socket，通过是否收到数据包判断是否在接收
+    auto up = Socket::createSocket(poller);
+    atomic<int> received(0);
+    up->setOnRead([&](const Buffer::Ptr &, struct sockaddr *, int) {
+        ++received;
+    });
+    up->bindUdpSock(0, "127.0.0.1");
+    auto fd_send = SockUtil::bindUdpSock(0, "127.0.0.1");
+    struct sockaddr addr;
+    SockUtil::getDomainIP("127.0.0.1", up->get_local_port(), addr);
+    auto sendPacket = [&]() {
+        ::sendto(fd_send, "x", 1, 0, &addr, sizeof(struct sockaddr_in));
+    };
+
+    //下游为tcp socket，对端暂不读取，使发送缓存堆积
+    auto listen_fd = SockUtil::listen(0, "127.0.0.1");
+    SockUtil::setNoBlocked(listen_fd, false);
+    auto down = Socket::createSocket(poller);
+    atomic<bool> high(false);
+    down->setOnWatermark([&](bool is_high) {
+        high = is_high;
+    });
+    down->setSendWatermark(kHighWatermark, kLowWatermark);
+    down->addBackpressureSocket(up);
+    down->connect("127.0.0.1", SockUtil::get_local_port(listen_fd), [](const SockException &) {}, 3);
+    auto fd_peer = (int) ::accept(listen_fd, nullptr, nullptr);
+    close(listen_fd);
+    SockUtil::setRecvBuf(fd_peer, 64 * 1024);
+
+    sendPacket();
+    bool ok = waitFor([&]() { return received == 1; });
+
+    //下游写满，达到高水位
+    string chunk(kChunkSize, 'a');
+    for (int i = 0; ok && !high && i < 1024; ++i) {
+        down->send(chunk);
+    }
+    ok = ok && waitFor([&]() { return high.load(); });
+    //上游被背压暂停
+    sendPacket();
+    bool paused = ok && noMorePackets(received, 1);
+
+    //背压期间使用者自己暂停接收，然后下游排空
+    up->enableRecv(false);
+    SockUtil::setNoBlocked(fd_peer, true);
+    char buf[64 * 1024];
+    ok = ok && waitFor([&]() {
+        while (::recv(fd_peer, buf, sizeof(buf), 0) > 0) {
+        }
+        return !high;
+    });
+    //水位回落后上游仍保持使用者设置的暂停状态
+    sendPacket();
+    bool kept = ok && noMorePackets(received, 1);
+
+    //使用者恢复接收后收到暂停期间的数据包
+    up->enableRecv(true);
+    bool resumed = ok && waitFor([&]() { return received == 3; });
+
+    ok = ok && paused && kept && resumed;
+    InfoL << "背压暂停接收:" << paused << ", 水位回落后保持使用者暂停:" << kept << ", 使用者恢复接收:" << resumed
+          << (ok ? ", 通过" : ", 失败");
+    poller->sync([&]() {
+        up->closeSock();
+        down->closeSock();
+    });
+    close(fd_send);
+    close(fd_peer);
+    return ok;
+}
+
+/**
+ * 未启用互斥锁的socket在其他线程发送数据：转交中的数据计入发送缓存字节数，连接断开后发送返回-1
+ */
+static bool testForeignSend() {
+    auto poller = EventPollerPool::Instance().getPoller();
+    auto listen_fd = SockUtil::listen(0, "127.0.0.1");
+    SockUtil::setNoBlocked(listen_fd, false);
+    auto sock = Socket::createSocket(poller, false);
+    atomic<bool> connected(false);
+    sock->connect("127.0.0.1", SockUtil::get_local_port(listen_fd), [&](const SockException &ex) { connected = !ex; }, 3);
+    auto fd_peer = (int) ::accept(listen_fd, nullptr, nullptr);
+    close(listen_fd);
+    //连接结果在poller线程中回调，之后才能发送
+    waitFor([&]() { return connected.load(); });
+
+    //阻塞poller线程，使数据停留在转交途中
+    semaphore sem;
+    poller->async([&]() {
+        sem.wait();
+    });
+    string chunk(kChunkSize, 'a');
+    auto ret = sock->send(chunk);
+    auto bytes = sock->getSendBufferBytes();
+    sem.post();
+    //转交完成并写入socket后字节数回落
+    bool drained = waitFor([&]() { return sock->getSendBufferBytes() == 0; });
+
+    poller->sync([&]() {
+        sock->closeSock();
+    });
+    auto ret_closed = sock->send(chunk);
+    bool ok = ret == (ssize_t) kChunkSize && bytes == kChunkSize && drained && ret_closed == -1;
+    InfoL << "跨线程发送, 返回值:" << ret << ", 转交中的发送缓存字节数:" << bytes << ", 断开后返回值:" << ret_closed
+          << (ok ? ", 通过" : ", 失败");
+    close(fd_peer);
+    return ok;
+}
+
+/**
+ * 发送缓存水位背压功能测试
+ */
+int main() {
+    signal(SIGINT, [](int) { exit(0); });
+    //初始化日志系统
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+
+    bool ok = testBackpressure();
+    ok = testForeignSend() && ok;
+    if (!ok) {
+        ErrorL << "背压测试失败";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,100 @@
+﻿/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/xia-chu/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <signal.h>
+#include <map>
+#include <vector>
+#include <iostream>
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Poller/EventPoller.h"
+
+using namespace std;
+using namespace toolkit;
+
+#if defined(__linux__)
+//获取调用线程允许运行的cpu核心
+static vector<int> getThreadCpus() {
+    vector<int> ret;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                ret.emplace_back(cpu);
+            }
+        }
+    }
+    return ret;
+}
+#endif
+
+/**
+ * EventPoller按numa亲和性策略绑定cpu核心，个数超过可用cpu核心数时循环绑定：
+ * 每个轮询线程只允许运行在其绑定的核心上，线程记录的numa节点与该核心一致，
+ * 前N个EventPoller占满全部N个可用核心，且在各numa节点间轮流分布
+ */
+static bool testAffinity() {
+    auto cpus = getAvailableCpus();
+    auto size = cpus.size() + 1;
+    EventPollerPool::setPoolSize((int) size, EventPollerPool::AFFINITY_NUMA);
+
+    bool ok = true;
+    vector<int> bound;
+    EventPollerPool::Instance().for_each([&](const TaskExecutor::Ptr &executor) {
+        auto poller = static_pointer_cast<EventPoller>(executor);
+        auto cpu = poller->getCpu();
+        bound.emplace_back(cpu);
+        poller->sync([&]() {
+            auto node = getThreadNumaNode();
+#if defined(__linux__)
+            auto allowed = getThreadCpus();
+            ok = ok && allowed.size() == 1 && allowed[0] == cpu && sched_getcpu() == cpu;
+#endif
+            ok = ok && node == getCpuNumaNode(cpu);
+            InfoL << "EventPoller绑定cpu:" << cpu << ", numa节点:" << node;
+        });
+    });
+
+    ok = ok && bound.size() == size;
+    //前N个EventPoller各绑定一个不同的核心，第N+1个循环绑定至第一个核心
+    map<int, int> count;
+    for (size_t i = 0; ok && i < cpus.size(); ++i) {
+        ok = ++count[bound[i]] == 1;
+    }
+    ok = ok && count.size() == cpus.size() && bound.back() == bound.front();
+    //相邻的EventPoller优先分布在不同numa节点
+    map<int, size_t> nodes;
+    for (auto cpu : cpus) {
+        ++nodes[getCpuNumaNode(cpu)];
+    }
+    if (ok && nodes.size() > 1) {
+        ok = getCpuNumaNode(bound[0]) != getCpuNumaNode(bound[1]);
+    }
+    InfoL << "可用cpu核心数:" << cpus.size() << ", numa节点数:" << nodes.size() << ", EventPoller个数:" << bound.size()
+          << (ok ? ", 通过" : ", 失败");
+    return ok;
+}
+
+/**
+ * EventPollerPool cpu亲和性功能测试
+ */
+int main() {
+    signal(SIGINT, [](int) { exit(0); });
+    //初始化日志系统
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+
+    bool ok = testAffinity();
+    if (!ok) {
+        ErrorL << "cpu亲和性测试失败";
+        return 1;
+    }
+    return 0;
+}
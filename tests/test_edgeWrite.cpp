@@ -0,0 +1,175 @@
+﻿/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/xia-chu/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <signal.h>
+#include <atomic>
+#include <thread>
+#include <iostream>
+#include "Util/logger.h"
+#include "Network/Socket.h"
+
+using namespace std;
+using namespace toolkit;
+
+//每轮发送的数据块个数与大小
+static constexpr int kChunkCount = 1024;
+static constexpr size_t kChunkSize = 16 * 1024;
+
+//第index个数据块的内容
+static string makeChunk(int index) {
+    string ret(kChunkSize, 'a' + index % 26);
+    memcpy(&ret[0], &index, sizeof(index));
+    return ret;
+}
+
+/**
+ * 监听本地端口，在后台线程中时快时慢地读取所有数据并校验，使发送端反复进入拥塞与恢复
+ */
+class Receiver {
+public:
+    Receiver() {
+        _listen_fd = SockUtil::listen(0, "127.0.0.1");
+        SockUtil::setNoBlocked(_listen_fd, false);
+        _port = SockUtil::get_local_port(_listen_fd);
+        _thread = thread([this]() {
+            auto fd = (int) ::accept(_listen_fd, nullptr, nullptr);
+            SockUtil::setNoBlocked(fd, false);
+            SockUtil::setRecvBuf(fd, 64 * 1024);
+            string chunk;
+            char buf[16 * 1024];
+            int reads = 0;
+            while (_chunks < kChunkCount) {
+                auto n = ::recv(fd, buf, sizeof(buf), 0);
+                if (n <= 0) {
+                    break;
+                }
+                chunk.append(buf, n);
+                while (chunk.size() >= kChunkSize) {
+                    _ok = _ok && chunk.compare(0, kChunkSize, makeChunk(_chunks)) == 0;
+                    chunk.erase(0, kChunkSize);
+                    ++_chunks;
+                }
+                if (++reads % 64 == 0) {
+                    //停顿一段时间，让发送端的socket写满
+                    usleep(20 * 1000);
+                }
+            }
+            close(fd);
+        });
+    }
+
+    ~Receiver() {
+        wait();
+        close(_listen_fd);
+    }
+
+    uint16_t port() const {
+        return _port;
+    }
+
+    //等待接收完毕，返回收到的完整且内容正确的数据块个数
+    int wait() {
+        if (_thread.joinable()) {
+            _thread.join();
+        }
+        return _ok ? (int) _chunks : -1;
+    }
+
+private:
+    int _listen_fd;
+    uint16_t _port;
+    atomic<bool> _ok {true};
+    atomic<size_t> _chunks {0};
+    thread _thread;
+};
+
+//连接并等待连接结果
+static bool connectTo(const Socket::Ptr &sock, uint16_t port) {
+    atomic<int> result(-1);
+    sock->connect("127.0.0.1", port, [&](const SockException &ex) { result = ex ? 0 : 1; }, 3);
+    for (int i = 0; i < 300 && result == -1; ++i) {
+        usleep(10 * 1000);
+    }
+    return result == 1;
+}
+
+/**
+ * 开启可写事件常驻监听后，数据在反复拥塞后仍能全部按序发出，不会因错过可写边沿而停滞
+ * @param from_poller 是否在poller线程中发送，否则在其他线程中发送
+ */
+static bool testTransfer(bool from_poller) {
+    auto poller = EventPollerPool::Instance().getPoller();
+    int chunks;
+    Ticker ticker;
+    {
+        Receiver receiver;
+        auto sock = Socket::createSocket(poller, false);
+        sock->enableEdgeWrite(true);
+        connectTo(sock, receiver.port());
+        if (from_poller) {
+            //每次发送一个数据块后让出poller线程，使可写事件有机会在发送过程中触发
+            for (int i = 0; i < kChunkCount; ++i) {
+                poller->sync([&]() { sock->send(makeChunk(i)); });
+            }
+        } else {
+            for (int i = 0; i < kChunkCount; ++i) {
+                sock->send(makeChunk(i));
+            }
+        }
+        chunks = receiver.wait();
+        poller->sync([&]() { sock->closeSock(); });
+    }
+    bool ok = chunks == kChunkCount;
+    InfoL << "可写事件常驻监听, " << (from_poller ? "poller线程" : "其他线程") << "发送, 收到数据块:" << chunks << "/" << kChunkCount
+          << ", 耗时:" << ticker.elapsedTime() << "ms" << (ok ? ", 通过" : ", 失败");
+    return ok;
+}
+
+/**
+ * 在发送缓存积压时开启可写事件常驻监听，积压的数据应继续发出
+ */
+static bool testToggle() {
+    auto poller = EventPollerPool::Instance().getPoller();
+    int chunks;
+    {
+        Receiver receiver;
+        auto sock = Socket::createSocket(poller, false);
+        connectTo(sock, receiver.port());
+        for (int i = 0; i < kChunkCount; ++i) {
+            sock->send(makeChunk(i));
+            if (i == kChunkCount / 2) {
+                sock->enableEdgeWrite(true);
+            }
+        }
+        chunks = receiver.wait();
+        poller->sync([&]() { sock->closeSock(); });
+    }
+    bool ok = chunks == kChunkCount;
+    InfoL << "发送过程中开启可写事件常驻监听, 收到数据块:" << chunks << "/" << kChunkCount << (ok ? ", 通过" : ", 失败");
+    return ok;
+}
+
+/**
+ * Socket::enableEdgeWrite功能测试
+ */
+int main() {
+    signal(SIGINT, [](int) { exit(0); });
+    //初始化日志系统
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+
+    bool ok = testTransfer(true);
+    ok = testTransfer(false) && ok;
+    ok = testToggle() && ok;
+    if (!ok) {
+        ErrorL << "可写事件常驻监听测试失败";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,201 @@
+﻿/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/xia-chu/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <atomic>
+#include <iostream>
+#include "Util/logger.h"
+#include "Poller/EventPoller.h"
+#include "Thread/semaphore.h"
+
+using namespace std;
+using namespace toolkit;
+
+//测试轮数
+static constexpr int kRounds = 100;
+
+//创建非阻塞管道
+static void makePipe(int fds[2]) {
+    if (pipe(fds) != 0) {
+        throw std::runtime_error("创建管道失败");
+    }
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+}
+
+//读空管道
+static void drainPipe(int fd) {
+    char buf[64];
+    while (::read(fd, buf, sizeof(buf)) > 0) {
+    }
+}
+
+/**
+ * 两个管道在同一批次中可读，先触发的回调删除另一个管道的监听并关闭它，
+ * 再以相同的fd号添加一个不可读的新管道；同批次中被删除管道的老事件既不能触发老回调，也不能触发新回调
+ */
+static bool testRound(const EventPoller::Ptr &poller, int &stale) {
+    int pipes[2][2];
+    makePipe(pipes[0]);
+    makePipe(pipes[1]);
+    int new_pipe[2] = {-1, -1};
+    atomic<int> new_fired(0);
+    //被替换掉的管道序号
+    int replaced = -1;
+
+    poller->sync([&]() {
+        for (int i = 0; i < 2; ++i) {
+            poller->addEvent(pipes[i][0], Event_Read, [&, i](int) {
+                if (replaced == i) {
+                    //已被删除的监听不应再触发
+                    ++stale;
+                    return;
+                }
+                drainPipe(pipes[i][0]);
+                if (replaced != -1) {
+                    return;
+                }
+                //替换另一个管道，新管道复用其fd号
+                replaced = 1 - i;
+                auto old_fd = pipes[replaced][0];
+                poller->delEvent(old_fd);
+                close(old_fd);
+                int fds[2];
+                makePipe(fds);
+                if (fds[0] != old_fd) {
+                    dup2(fds[0], old_fd);
+                    close(fds[0]);
+                }
+                new_pipe[0] = old_fd;
+                new_pipe[1] = fds[1];
+                poller->addEvent(new_pipe[0], Event_Read, [&](int) {
+                    drainPipe(new_pipe[0]);
+                    ++new_fired;
+                });
+            });
+        }
+        //两个管道同时可读，在同一批次中触发
+        ::write(pipes[0][1], "a", 1);
+        ::write(pipes[1][1], "b", 1);
+    });
+
+    //等待批次处理完毕
+    for (int i = 0; i < 100 && replaced == -1; ++i) {
+        usleep(1000);
+    }
+    poller->sync([]() {});
+    bool ok = replaced != -1 && new_fired == 0;
+
+    //新管道可读时应触发新回调
+    if (ok) {
+        ::write(new_pipe[1], "c", 1);
+        for (int i = 0; i < 100 && new_fired == 0; ++i) {
+            usleep(1000);
+        }
+        ok = new_fired == 1;
+    }
+
+    poller->sync([&]() {
+        int keep = replaced == -1 ? 0 : 1 - replaced;
+        poller->delEvent(pipes[keep][0]);
+        if (replaced != -1) {
+            poller->delEvent(new_pipe[0]);
+        }
+    });
+    for (int i = 0; i < 2; ++i) {
+        close(pipes[i][0]);
+        close(pipes[i][1]);
+    }
+    if (new_pipe[1] != -1) {
+        close(new_pipe[1]);
+    }
+    return ok;
+}
+
+/**
+ * fd号被复用后，老监听的残留事件不会触发新监听的回调
+ */
+static bool testReuse() {
+    auto poller = EventPollerPool::Instance().getPoller();
+    int stale = 0;
+    int failed = 0;
+    for (int i = 0; i < kRounds; ++i) {
+        if (!testRound(poller, stale)) {
+            ++failed;
+        }
+    }
+    bool ok = failed == 0 && stale == 0;
+    InfoL << "fd号复用, 失败轮数:" << failed << "/" << kRounds << ", 老回调误触发次数:" << stale << (ok ? ", 通过" : ", 失败");
+    return ok;
+}
+
+/**
+ * 其他线程调用modifyEvent后，修改执行前fd被删除并以相同fd号重新添加，修改不能作用于新的监听；
+ * 未监听的fd调用modifyEvent应返回-1
+ */
+static bool testCrossThreadModify() {
+    auto poller = EventPollerPool::Instance().getPoller();
+    int old_pair[2], new_pair[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, old_pair);
+    socketpair(AF_UNIX, SOCK_STREAM, 0, new_pair);
+    auto fd = old_pair[0];
+    atomic<int> new_write(0);
+    poller->sync([&]() {
+        poller->addEvent(fd, Event_Read, [](int) {});
+    });
+
+    //阻塞poller线程，使跨线程修改排在fd替换之后执行
+    semaphore sem;
+    poller->async([&]() {
+        sem.wait();
+        poller->delEvent(fd);
+        //socketpair总是可写，新监听只在被错误地加上可写监听时触发可写事件
+        dup2(new_pair[0], fd);
+        poller->addEvent(fd, Event_Read, [&](int event) {
+            if (event & Event_Write) {
+                ++new_write;
+            }
+        });
+    });
+    auto ret = poller->modifyEvent(fd, Event_Read | Event_Write);
+    auto ret_unknown = poller->modifyEvent(new_pair[1], Event_Read);
+    sem.post();
+
+    usleep(50 * 1000);
+    poller->sync([&]() {
+        poller->delEvent(fd);
+    });
+    bool ok = ret == 0 && ret_unknown == -1 && new_write == 0;
+    InfoL << "跨线程修改监听, 返回值:" << ret << ", 未监听fd返回值:" << ret_unknown << ", 新监听误触发可写次数:" << new_write
+          << (ok ? ", 通过" : ", 失败");
+    for (int i = 0; i < 2; ++i) {
+        close(old_pair[i]);
+        close(new_pair[i]);
+    }
+    return ok;
+}
+
+/**
+ * EventPoller监听记录表fd号复用测试
+ */
+int main() {
+    signal(SIGINT, [](int) { exit(0); });
+    //初始化日志系统
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+
+    bool ok = testReuse();
+    ok = testCrossThreadModify() && ok;
+    if (!ok) {
+        ErrorL << "fd号复用测试失败";
+        return 1;
+    }
+    return 0;
+}
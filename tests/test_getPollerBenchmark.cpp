@@ -0,0 +1,101 @@
+﻿/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/xia-chu/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <signal.h>
+#include <cmath>
+#include <chrono>
+#include <vector>
+#include <iostream>
+#include <unordered_map>
+#include "Util/logger.h"
+#include "Util/TimeTicker.h"
+#include "Poller/EventPoller.h"
+
+using namespace std;
+using namespace toolkit;
+
+//模拟连接建立时在poller线程中的开销，不同连接开销不同
+static void onConnection(int cost) {
+    volatile uint64_t sum = 0;
+    for (int i = 0; i < cost * 100; ++i) {
+        sum += i;
+    }
+}
+
+/**
+ * 通过EventPollerPool::getPoller模拟建立大量连接，统计各选择策略的耗时与连接分布的偏斜程度
+ * 用法: test_getPollerBenchmark [连接数] [poller个数]
+ */
+int main(int argc, char *argv[]) {
+    signal(SIGINT, [](int) {
+        exit(0);
+    });
+    //初始化日志系统
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+
+    int connections = argc > 1 ? atoi(argv[1]) : 100 * 1000;
+    int poller_count = argc > 2 ? atoi(argv[2]) : 8;
+    EventPollerPool::setPoolSize(poller_count);
+    auto &pool = EventPollerPool::Instance();
+    pool.preferCurrentThread(false);
+
+    unordered_map<EventPoller *, size_t> poller_index;
+    pool.for_each([&](const TaskExecutor::Ptr &executor) {
+        auto index = poller_index.size();
+        poller_index.emplace(static_cast<EventPoller *>(executor.get()), index);
+    });
+
+    struct {
+        TaskExecutorGetterImp::Policy policy;
+        const char *name;
+    } policies[] = {
+        {TaskExecutorGetterImp::POLICY_MIN_LOAD, "min_load   "},
+        {TaskExecutorGetterImp::POLICY_ROUND_ROBIN, "round_robin"},
+        {TaskExecutorGetterImp::POLICY_TWO_CHOICES, "two_choices"},
+        {TaskExecutorGetterImp::POLICY_QUEUE_DEPTH, "queue_depth"},
+    };
+
+    for (auto &item : policies) {
+        pool.setPolicy(item.policy);
+        //单次getPoller耗时远小于getCurrentMicrosecond的刷新精度，所以整体计时后取平均
+        auto begin = chrono::steady_clock::now();
+        for (int i = 0; i < connections; ++i) {
+            pool.getPoller();
+        }
+        auto select_ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - begin).count();
+
+        vector<size_t> counts(poller_index.size());
+        Ticker ticker;
+        for (int i = 0; i < connections; ++i) {
+            auto poller = pool.getPoller();
+            ++counts[poller_index[poller.get()]];
+            int cost = i % 16;
+            poller->post([cost]() { onConnection(cost); }, false);
+        }
+        //等待所有poller处理完毕
+        pool.for_each([](const TaskExecutor::Ptr &executor) {
+            executor->sync([]() {});
+        });
+
+        double mean = (double) connections / counts.size();
+        double variance = 0;
+        size_t max_count = 0, min_count = connections;
+        for (auto count : counts) {
+            variance += (count - mean) * (count - mean);
+            max_count = max(max_count, count);
+            min_count = min(min_count, count);
+        }
+        auto stddev = sqrt(variance / counts.size());
+        InfoL << item.name << " " << connections << "个连接, " << counts.size() << "个poller, 总耗时:" << ticker.elapsedTime()
+              << "ms, getPoller平均耗时:" << select_ns / connections << "ns, 最多:" << max_count << ", 最少:" << min_count
+              << ", 最多/平均:" << max_count / mean << ", 变异系数:" << stddev / mean;
+    }
+    return 0;
+}
@@ -0,0 +1,202 @@
+﻿/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/xia-chu/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <signal.h>
+#include <atomic>
+#include <vector>
+#include <iostream>
+#if defined(__linux__) || defined(__linux)
+#include <dlfcn.h>
+#endif
+#include "Util/logger.h"
+#include "Network/Socket.h"
+#include "Network/BufferSlab.h"
+
+using namespace std;
+using namespace toolkit;
+
+//udp数据包个数，每批发送的个数
+static constexpr int kPacketCount = 1000;
+static constexpr int kBatchCount = 50;
+//模拟rtp数据包大小
+static constexpr size_t kPacketSize = 1400;
+//大数据包大小，超过2K接收缓存，需要合并溢出部分
+static constexpr size_t kLargePacketSize = 32 * 1024;
+
+//第index个数据包的内容
+static string makePacket(int index, size_t size) {
+    string ret(size, 'a' + index % 26);
+    memcpy(&ret[0], &index, sizeof(index));
+    return ret;
+}
+
+#if defined(__linux__) || defined(__linux)
+
+//被监视的udp socket
+static int s_watch_fd = -1;
+//recvmmsg写入的各数据包首个iovec地址，按接收顺序排列，只在poller线程中访问
+static vector<void *> s_filled;
+
+//拦截recvmmsg，记录内核写入数据的内存地址
+extern "C" int recvmmsg(int fd, struct mmsghdr *vmessages, unsigned int vlen, int flags, struct timespec *tmo) {
+    using recvmmsg_t = int (*)(int, struct mmsghdr *, unsigned int, int, struct timespec *);
+    static auto s_recvmmsg = (recvmmsg_t) dlsym(RTLD_NEXT, "recvmmsg");
+    auto n = s_recvmmsg(fd, vmessages, vlen, flags, tmo);
+    if (fd == s_watch_fd) {
+        for (int i = 0; i < n; ++i) {
+            s_filled.emplace_back(vmessages[i].msg_hdr.msg_iov[0].iov_base);
+        }
+    }
+    return n;
+}
+
+#endif
+
+//64K分级内存块的累计分配次数
+static uint64_t getLargeBlockAlloc() {
+    for (auto &item : BufferSlab::getStatistic()) {
+        if (item.block_size == 64 * 1024) {
+            return item.alloc;
+        }
+    }
+    return 0;
+}
+
+//等待计数达到期望值
+static bool waitCount(const atomic<size_t> &count, size_t expect) {
+    for (int i = 0; i < 300 && count < expect; ++i) {
+        usleep(10 * 1000);
+    }
+    return count >= expect;
+}
+
+/**
+ * udp独享接收缓存，使用者持有所有数据包，数据包内容不能被后续读取覆盖，
+ * 小数据包就是recvmmsg写入的缓存(未经拷贝)，且只占用2K内存块而不是整块64K接收缓存
+ */
+static bool testUdp() {
+    auto poller = EventPollerPool::Instance().getPoller();
+    auto sock = Socket::createSocket(poller, false);
+    sock->enableRecvBufferPool(true);
+    sock->bindUdpSock(0, "127.0.0.1");
+#if defined(__linux__) || defined(__linux)
+    poller->sync([&]() {
+        s_watch_fd = sock->rawFD();
+    });
+#endif
+    vector<Buffer::Ptr> packets;
+    atomic<size_t> received(0);
+    sock->setOnRead([&](const Buffer::Ptr &buf, struct sockaddr *, int) {
+        packets.emplace_back(buf);
+        ++received;
+    });
+
+    auto fd_send = SockUtil::bindUdpSock(0, "127.0.0.1");
+    struct sockaddr addr;
+    SockUtil::getDomainIP("127.0.0.1", sock->get_local_port(), addr);
+    auto alloc = getLargeBlockAlloc();
+    bool ok = true;
+    for (int i = 0; i < kPacketCount + 1 && ok; i += kBatchCount) {
+        //分批发送，防止socket接收缓冲区溢出丢包
+        for (int j = i; j < i + kBatchCount && j < kPacketCount + 1; ++j) {
+            auto packet = makePacket(j, j == kPacketCount ? kLargePacketSize : kPacketSize);
+            ::sendto(fd_send, packet.data(), packet.size(), 0, &addr, sizeof(struct sockaddr_in));
+        }
+        ok = waitCount(received, min(i + kBatchCount, kPacketCount + 1));
+    }
+    close(fd_send);
+    alloc = getLargeBlockAlloc() - alloc;
+
+    size_t capacity = 0;
+    size_t copied = 0;
+    poller->sync([&]() {
+        ok = ok && packets.size() == (size_t) kPacketCount + 1;
+        for (size_t i = 0; ok && i < packets.size(); ++i) {
+            auto size = i == (size_t) kPacketCount ? kLargePacketSize : kPacketSize;
+            ok = string(packets[i]->data(), packets[i]->size()) == makePacket((int) i, size);
+            if (i < (size_t) kPacketCount) {
+                capacity += packets[i]->getCapacity();
+#if defined(__linux__) || defined(__linux)
+                //小数据包应是recvmmsg直接写入的内存
+                if (i >= s_filled.size() || packets[i]->data() != s_filled[i]) {
+                    ++copied;
+                }
+#endif
+            }
+        }
+#if defined(__linux__) || defined(__linux)
+        s_watch_fd = -1;
+#endif
+        sock->closeSock();
+    });
+    //小数据包占用2K分级内存块，只有大数据包替换了接收缓存
+    ok = ok && copied == 0 && capacity <= kPacketCount * 2 * 1024 && alloc <= 2;
+    InfoL << "udp独享接收缓存, 收到数据包:" << received << "/" << kPacketCount + 1 << ", 被拷贝的小数据包:" << copied
+          << ", 小数据包占用内存:" << capacity << ", 新分配64K内存块:" << alloc << (ok ? ", 通过" : ", 失败");
+    return ok;
+}
+
+/**
+ * tcp独享接收缓存，使用者持有所有数据，拼接后应与发送的数据一致
+ */
+static bool testTcp() {
+    auto listen_fd = SockUtil::listen(0, "127.0.0.1");
+    SockUtil::setNoBlocked(listen_fd, false);
+    auto poller = EventPollerPool::Instance().getPoller();
+    auto sock = Socket::createSocket(poller, false);
+    sock->enableRecvBufferPool(true);
+    vector<Buffer::Ptr> buffers;
+    atomic<size_t> received(0);
+    sock->setOnRead([&](const Buffer::Ptr &buf, struct sockaddr *, int) {
+        buffers.emplace_back(buf);
+        received += buf->size();
+    });
+    sock->connect("127.0.0.1", SockUtil::get_local_port(listen_fd), [](const SockException &) {}, 3);
+    auto fd_send = (int) ::accept(listen_fd, nullptr, nullptr);
+    close(listen_fd);
+    SockUtil::setNoBlocked(fd_send, false);
+
+    string expect;
+    for (int i = 0; i < kPacketCount; ++i) {
+        expect += makePacket(i, kPacketSize);
+    }
+    bool ok = ::send(fd_send, expect.data(), expect.size(), 0) == (ssize_t) expect.size();
+    ok = waitCount(received, expect.size()) && ok;
+    close(fd_send);
+
+    string data;
+    poller->sync([&]() {
+        for (auto &buf : buffers) {
+            data.append(buf->data(), buf->size());
+        }
+        sock->closeSock();
+    });
+    ok = ok && data == expect;
+    InfoL << "tcp独享接收缓存, 收到字节数:" << data.size() << "/" << expect.size() << ", 读取次数:" << buffers.size()
+          << (ok ? ", 通过" : ", 失败");
+    return ok;
+}
+
+/**
+ * 独享接收缓存(enableRecvBufferPool)功能测试
+ */
+int main() {
+    signal(SIGINT, [](int) { exit(0); });
+    //初始化日志系统
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+
+    bool ok = testUdp();
+    ok = testTcp() && ok;
+    if (!ok) {
+        ErrorL << "独享接收缓存测试失败";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,103 @@
+﻿/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/xia-chu/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <signal.h>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <iostream>
+#include "Util/logger.h"
+#include "Network/TcpServer.h"
+#include "Network/sockutil.h"
+
+using namespace std;
+using namespace toolkit;
+
+//poller线程数与客户端连接数
+static constexpr int kPollerCount = 4;
+static constexpr int kConnectionCount = 200;
+
+//各poller线程接收到的连接数
+static mutex s_mtx;
+static map<EventPoller *, int> s_accepted;
+static atomic<int> s_total{0};
+
+class CountSession : public TcpSession {
+public:
+    CountSession(const Socket::Ptr &sock) : TcpSession(sock) {
+        {
+            lock_guard<mutex> lck(s_mtx);
+            ++s_accepted[getPoller().get()];
+        }
+        ++s_total;
+    }
+
+    void onRecv(const Buffer::Ptr &/*buf*/) override {}
+
+    void onError(const SockException &/*err*/) override {}
+
+    void onManager() override {}
+};
+
+/**
+ * 开启SO_REUSEPORT后每个poller线程独立监听，由内核按连接四元组分发，所有poller线程都应接收到连接
+ */
+static bool testSpread() {
+    auto server = std::make_shared<TcpServer>();
+    server->setReusePort(true);
+    server->start<CountSession>(0, "127.0.0.1");
+    auto port = server->getPort();
+
+    vector<int> clients;
+    for (int i = 0; i < kConnectionCount; ++i) {
+        auto fd = SockUtil::connect("127.0.0.1", port, false);
+        if (fd != -1) {
+            clients.emplace_back(fd);
+        }
+    }
+    for (int i = 0; i < 300 && s_total < (int) clients.size(); ++i) {
+        usleep(10 * 1000);
+    }
+
+    bool ok = (int) clients.size() == kConnectionCount && s_total == kConnectionCount;
+    size_t pollers = 0;
+    {
+        lock_guard<mutex> lck(s_mtx);
+        for (auto &pr : s_accepted) {
+            InfoL << "poller " << pr.first << " 接收连接数:" << pr.second;
+        }
+        pollers = s_accepted.size();
+    }
+    ok = ok && pollers == (size_t) kPollerCount;
+    for (auto fd : clients) {
+        close(fd);
+    }
+    InfoL << "SO_REUSEPORT分发连接, 接收连接数:" << s_total << "/" << kConnectionCount << ", 接收连接的poller个数:" << pollers
+          << "/" << kPollerCount << (ok ? ", 通过" : ", 失败");
+    return ok;
+}
+
+/**
+ * TcpServer SO_REUSEPORT多线程监听功能测试
+ */
+int main() {
+    signal(SIGINT, [](int) { exit(0); });
+    //初始化日志系统
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+    EventPollerPool::setPoolSize(kPollerCount);
+
+    bool ok = testSpread();
+    if (!ok) {
+        ErrorL << "SO_REUSEPORT测试失败";
+        return 1;
+    }
+    return 0;
+}
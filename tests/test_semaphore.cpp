@@ -11,6 +11,9 @@
 #include <signal.h>
 #include <iostream>
 #include <atomic>
+#include <string>
+#include <mutex>
+#include <condition_variable>
 #include <Util/TimeTicker.h>
 #include "Util/logger.h"
 #include "Thread/threadgroup.h"
@@ -46,10 +49,81 @@ void onProduce() {
         }
     }
 }
-int main() {
+//基于条件变量的信号量，作为对比基准
+class CondSemaphore {
+public:
+    void post(size_t n = 1) {
+        unique_lock<mutex> lock(_mutex);
+        _count += n;
+        if (n == 1) {
+            _condition.notify_one();
+        } else {
+            _condition.notify_all();
+        }
+    }
+    void wait() {
+        unique_lock<mutex> lock(_mutex);
+        while (_count == 0) {
+            _condition.wait(lock);
+        }
+        --_count;
+    }
+private:
+    size_t _count = 0;
+    mutex _mutex;
+    condition_variable _condition;
+};
+
+//多生产者多消费者竞争测试，统计每秒post/wait次数
+template<typename SEM>
+void benchmark(const char *name, int producers, int consumers, long long total) {
+    SEM sem;
+    atomic_llong consumed(0);
+    Ticker ticker;
+    thread_group thread_consumer;
+    for (int i = 0; i < consumers; ++i) {
+        thread_consumer.create_thread([&]() {
+            while (true) {
+                sem.wait();
+                if (++consumed > total) {
+                    break;
+                }
+            }
+        });
+    }
+    thread_group thread_producer;
+    for (int i = 0; i < producers; ++i) {
+        thread_producer.create_thread([&]() {
+            for (long long j = 0; j < total / producers; ++j) {
+                sem.post();
+            }
+        });
+    }
+    thread_producer.join_all();
+    //补足整除产生的误差，并让所有消费者线程退出
+    sem.post(total % producers + consumers);
+    thread_consumer.join_all();
+    auto elapsed = ticker.elapsedTime();
+    InfoL << name << " " << producers << "个生产者, " << consumers << "个消费者, " << total << "次post/wait, 耗时:" << elapsed
+          << "ms, 每秒次数:" << (elapsed ? total * 1000 / elapsed : total);
+}
+
+int main(int argc, char *argv[]) {
     //初始化log
     Logger::Instance().add(std::make_shared<ConsoleChannel>());
 
+    if (argc > 1 && string(argv[1]) == "bench") {
+        //用法: test_semaphore bench [post/wait总次数]
+        long long total = argc > 2 ? atoll(argv[2]) : 1000 * 1000;
+        for (auto producers : {1, 4}) {
+            for (auto consumers : {1, 4}) {
+                benchmark<CondSemaphore>("condition_variable", producers, consumers, total);
+                benchmark<semaphore>("semaphore         ", producers, consumers, total);
+            }
+        }
+        return 0;
+    }
+
     Ticker ticker;
     thread_group thread_producer;
     for (size_t i = 0; i < thread::hardware_concurrency(); ++i) {
@@ -0,0 +1,203 @@
+﻿/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/xia-chu/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <signal.h>
+#include <fcntl.h>
+#include <atomic>
+#include <thread>
+#include <iostream>
+#include "Util/logger.h"
+#include "Network/Socket.h"
+
+using namespace std;
+using namespace toolkit;
+
+//测试文件大小
+static constexpr size_t kFileSize = 4 * 1024 * 1024 + 123;
+
+/**
+ * 监听本地端口，在后台线程中缓慢读取所有数据直到对方断开，使发送端多次遇到缓冲区满
+ */
+class Receiver {
+public:
+    Receiver() {
+        _listen_fd = SockUtil::listen(0, "127.0.0.1");
+        SockUtil::setNoBlocked(_listen_fd, false);
+        _port = SockUtil::get_local_port(_listen_fd);
+        _thread = thread([this]() {
+            auto fd = (int) ::accept(_listen_fd, nullptr, nullptr);
+            SockUtil::setNoBlocked(fd, false);
+            SockUtil::setRecvBuf(fd, 64 * 1024);
+            char buf[16 * 1024];
+            int count = 0;
+            while (true) {
+                auto n = ::recv(fd, buf, sizeof(buf), 0);
+                if (n <= 0) {
+                    break;
+                }
+                _data.append(buf, n);
+                if (++count % 32 == 0) {
+                    usleep(1000);
+                }
+            }
+            close(fd);
+        });
+    }
+
+    ~Receiver() {
+        wait();
+        close(_listen_fd);
+    }
+
+    uint16_t port() const {
+        return _port;
+    }
+
+    //等待对方断开，返回收到的数据
+    const string &wait() {
+        if (_thread.joinable()) {
+            _thread.join();
+        }
+        return _data;
+    }
+
+private:
+    int _listen_fd;
+    uint16_t _port;
+    string _data;
+    thread _thread;
+};
+
+//创建内容各不相同的临时文件，返回文件描述符与文件内容
+static int createFile(string &content) {
+    char path[] = "/tmp/test_sendFile_XXXXXX";
+    auto fd = mkstemp(path);
+    if (fd == -1) {
+        return -1;
+    }
+    unlink(path);
+    content.resize(kFileSize);
+    for (size_t i = 0; i < kFileSize; ++i) {
+        content[i] = (char) (i * 131 + i / 4096);
+    }
+    if (::write(fd, content.data(), content.size()) != (ssize_t) content.size()) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static Socket::Ptr connectTo(uint16_t port) {
+    auto sock = Socket::createSocket(EventPollerPool::Instance().getPoller(), false);
+    atomic<int> result(-1);
+    sock->connect("127.0.0.1", port, [&](const SockException &ex) { result = ex ? 0 : 1; }, 3);
+    for (int i = 0; i < 300 && result == -1; ++i) {
+        usleep(10 * 1000);
+    }
+    return result == 1 ? sock : nullptr;
+}
+
+/**
+ * 文件数据与内存数据混合发送，接收端数据顺序与内容应与发送顺序一致，发送结果回调返回文件数据长度
+ */
+static bool testOrder() {
+    string content;
+    auto fd = createFile(content);
+    if (fd == -1) {
+        ErrorL << "创建临时文件失败:" << get_uv_errmsg();
+        return false;
+    }
+    atomic<size_t> result1(-1), result2(-1);
+    string data;
+    bool ok;
+    {
+        Receiver receiver;
+        auto sock = connectTo(receiver.port());
+        ok = sock != nullptr;
+        if (ok) {
+            sock->getPoller()->sync([&]() {
+                sock->send("HEAD");
+                sock->sendFile(fd, 1000, 3000000, [&](size_t n) { result1 = n; });
+                sock->send("TAIL");
+                sock->sendFile(fd, 0, kFileSize, [&](size_t n) { result2 = n; });
+                sock->send("END");
+            });
+            //sendFile内部复制了文件描述符，调用后可以立即关闭
+            close(fd);
+            fd = -1;
+            for (int i = 0; i < 1000 && (result1 == (size_t) -1 || result2 == (size_t) -1); ++i) {
+                usleep(10 * 1000);
+            }
+            sock->getPoller()->sync([&]() { sock->closeSock(); });
+        }
+        data = receiver.wait();
+    }
+    if (fd != -1) {
+        close(fd);
+    }
+    auto expect = "HEAD" + content.substr(1000, 3000000) + "TAIL" + content + "END";
+    ok = ok && data == expect && result1 == 3000000 && result2 == kFileSize;
+    InfoL << "文件与内存数据混合发送, 收到字节数:" << data.size() << "/" << expect.size() << ", 回调:" << result1 << "," << result2
+          << (ok ? ", 通过" : ", 失败");
+    return ok;
+}
+
+/**
+ * 文件长度不足时发送失败，发送结果回调返回0并触发socket错误
+ */
+static bool testShortFile() {
+    string content;
+    auto fd = createFile(content);
+    if (fd == -1) {
+        ErrorL << "创建临时文件失败:" << get_uv_errmsg();
+        return false;
+    }
+    atomic<size_t> result(-1);
+    atomic<bool> on_err(false);
+    bool ok;
+    {
+        Receiver receiver;
+        auto sock = connectTo(receiver.port());
+        ok = sock != nullptr;
+        if (ok) {
+            sock->setOnErr([&](const SockException &) { on_err = true; });
+            sock->getPoller()->sync([&]() {
+                ok = sock->sendFile(fd, kFileSize - 100, 200, [&](size_t n) { result = n; }) == 200;
+            });
+            for (int i = 0; i < 300 && (result == (size_t) -1 || !on_err); ++i) {
+                usleep(10 * 1000);
+            }
+            sock->getPoller()->sync([&]() { sock->closeSock(); });
+        }
+    }
+    close(fd);
+    ok = ok && result == 0 && on_err;
+    InfoL << "文件长度不足, 回调:" << (ssize_t) result << ", 触发错误:" << on_err << (ok ? ", 通过" : ", 失败");
+    return ok;
+}
+
+/**
+ * Socket::sendFile功能测试
+ */
+int main() {
+    signal(SIGINT, [](int) { exit(0); });
+    //sendfile无法屏蔽SIGPIPE信号
+    signal(SIGPIPE, SIG_IGN);
+    //初始化日志系统
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+
+    bool ok = testOrder();
+    ok = testShortFile() && ok;
+    if (!ok) {
+        ErrorL << "sendFile测试失败";
+        return 1;
+    }
+    return 0;
+}
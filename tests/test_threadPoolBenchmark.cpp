@@ -10,21 +10,94 @@
 
 #include <signal.h>
 #include <atomic>
+#include <thread>
+#include <vector>
+#include <string>
 #include <iostream>
 #include "Util/logger.h"
 #include "Util/TimeTicker.h"
 #include "Thread/ThreadPool.h"
+#include "Thread/WorkStealingThreadPool.h"
 
 using namespace std;
 using namespace toolkit;
 
-int main() {
+/**
+ * 多个生产者线程同时投递任务，统计全部执行完毕的耗时
+ * @param pool 线程池
+ * @param producer 生产者线程数
+ * @param total 外部投递的任务总数
+ * @param nested 每个任务在线程池内部再投递的子任务数
+ */
+static void benchmark(const char *name, TaskExecutor &pool, int producer, int total, int nested) {
+    int per_producer = total / producer;
+    long long expect = (long long) per_producer * producer * (nested + 1);
+    atomic_llong count(0);
+    semaphore sem;
+    auto on_done = [&]() {
+        if (++count == expect) {
+            sem.post();
+        }
+    };
+
+    Ticker ticker;
+    vector<thread> threads;
+    for (int i = 0; i < producer; ++i) {
+        threads.emplace_back([&]() {
+            for (int j = 0; j < per_producer; ++j) {
+                pool.async([&]() {
+                    for (int k = 0; k < nested; ++k) {
+                        pool.async(on_done, false);
+                    }
+                    on_done();
+                }, false);
+            }
+        });
+    }
+    for (auto &th : threads) {
+        th.join();
+    }
+    auto enqueue_ms = ticker.elapsedTime();
+    sem.wait();
+    auto total_ms = ticker.elapsedTime();
+    InfoL << name << " " << producer << "个生产者线程, " << expect << "个任务(嵌套" << nested << "), 入队耗时:" << enqueue_ms
+          << "ms, 总耗时:" << total_ms << "ms, 每秒执行任务数:" << (total_ms ? expect * 1000 / total_ms : expect);
+}
+
+/**
+ * 对比ThreadPool与WorkStealingThreadPool
+ * 用法: test_threadPoolBenchmark compare [最大生产者线程数] [线程池线程数] [任务总数]
+ */
+static void compare(int argc, char *argv[]) {
+    int max_producer = argc > 2 ? atoi(argv[2]) : 4;
+    int thread_num = argc > 3 ? atoi(argv[3]) : max(2, (int) thread::hardware_concurrency());
+    int total = argc > 4 ? atoi(argv[4]) : 1000 * 1000;
+    for (int producer = 1; producer <= max_producer; producer *= 2) {
+        for (int nested : {0, 3}) {
+            {
+                ThreadPool pool(thread_num, ThreadPool::PRIORITY_HIGHEST, true);
+                benchmark("ThreadPool            ", pool, producer, total, nested);
+            }
+            {
+                WorkStealingThreadPool pool(thread_num, ThreadPool::PRIORITY_HIGHEST, true);
+                benchmark("WorkStealingThreadPool", pool, producer, total, nested);
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
     signal(SIGINT,[](int ){
         exit(0);
     });
     //初始化日志系统
     Logger::Instance().add(std::make_shared<ConsoleChannel> ());
 
+    if (argc > 1 && string(argv[1]) == "compare") {
+        compare(argc, argv);
+        return 0;
+    }
+
     atomic_llong count(0);
     ThreadPool pool(1,ThreadPool::PRIORITY_HIGHEST, false);
 
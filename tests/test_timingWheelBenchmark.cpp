@@ -0,0 +1,155 @@
+﻿/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/xia-chu/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <signal.h>
+#include <map>
+#include <vector>
+#include <random>
+#include <iostream>
+#include "Util/logger.h"
+#include "Util/TimeTicker.h"
+#include "Poller/TimingWheel.h"
+
+using namespace std;
+using namespace toolkit;
+
+//模拟的起始时间，故意不对齐槽边界
+static constexpr uint64_t kStartTime = 1234567;
+
+static void benchMultimap(const vector<uint64_t> &delays, uint64_t max_delay) {
+    multimap<uint64_t, size_t> timers;
+    Ticker ticker;
+    for (size_t i = 0; i < delays.size(); ++i) {
+        timers.emplace(kStartTime + delays[i], i);
+    }
+    auto insert_ms = ticker.elapsedTime();
+
+    size_t fired = 0;
+    for (auto now = kStartTime; now <= kStartTime + max_delay; ++now) {
+        for (auto it = timers.begin(); it != timers.end() && it->first <= now; it = timers.erase(it)) {
+            ++fired;
+        }
+    }
+    auto total_ms = ticker.elapsedTime();
+    InfoL << "multimap   " << delays.size() << "个定时器, 插入耗时:" << insert_ms << "ms, 到期耗时:" << total_ms - insert_ms
+          << "ms, 触发个数:" << fired;
+}
+
+/**
+ * @return 所有定时器是否均在到期时刻准时触发
+ */
+static bool benchTimingWheel(const vector<uint64_t> &delays, uint64_t max_delay) {
+    TimingWheel<size_t> timers(kStartTime);
+    Ticker ticker;
+    for (size_t i = 0; i < delays.size(); ++i) {
+        timers.add(kStartTime + delays[i], i);
+    }
+    auto insert_ms = ticker.elapsedTime();
+
+    size_t fired = 0;
+    size_t wrong = 0;
+    for (auto now = kStartTime; now <= kStartTime + max_delay; ++now) {
+        timers.advance(now, [&](size_t &index) {
+            ++fired;
+            if (kStartTime + delays[index] != now) {
+                //未在到期时刻准时触发
+                ++wrong;
+            }
+        });
+    }
+    auto total_ms = ticker.elapsedTime();
+    InfoL << "TimingWheel " << delays.size() << "个定时器, 插入耗时:" << insert_ms << "ms, 到期耗时:" << total_ms - insert_ms
+          << "ms, 触发个数:" << fired << ", 误差个数:" << wrong;
+    return fired == delays.size() && !wrong;
+}
+
+/**
+ * 取消一半的定时器：取消后立即从时间轮中移除并释放携带的数据，被取消的定时器不会触发；
+ * 到期回调中也可以取消本轮尚未触发的定时器
+ * @return 取消与触发的结果是否正确
+ */
+static bool benchCancel(const vector<uint64_t> &delays, uint64_t max_delay) {
+    //通过引用计数判断携带的数据是否已释放
+    struct Timer {
+        size_t index;
+        shared_ptr<int> ref;
+    };
+    TimingWheel<Timer> timers(kStartTime);
+    vector<TimingWheel<Timer>::Handle> handles(delays.size());
+    auto ref = make_shared<int>(0);
+    for (size_t i = 0; i < delays.size(); ++i) {
+        handles[i] = timers.add(kStartTime + delays[i], Timer { i, ref });
+    }
+
+    Ticker ticker;
+    size_t cancelled = 0;
+    for (size_t i = 0; i < delays.size(); i += 2) {
+        cancelled += timers.cancel(handles[i]);
+    }
+    auto cancel_ms = ticker.elapsedTime();
+    //被取消的定时器已释放携带的数据，重复取消无效
+    bool ok = cancelled == (delays.size() + 1) / 2 && timers.size() == delays.size() - cancelled
+              && (size_t) ref.use_count() == 1 + timers.size() && !timers.cancel(handles[0]);
+
+    size_t fired = 0;
+    size_t wrong = 0;
+    for (auto now = kStartTime; now <= kStartTime + max_delay; ++now) {
+        timers.advance(now, [&](Timer &timer) {
+            auto index = timer.index;
+            ++fired;
+            if (index % 2 == 0 || kStartTime + delays[index] != now) {
+                //被取消的定时器触发了或未准时触发
+                ++wrong;
+            }
+            if (index + 2 < delays.size() && timers.cancel(handles[index + 2])) {
+                //在回调中取消之后的定时器
+                ++cancelled;
+            }
+        });
+    }
+    ok = ok && fired + cancelled == delays.size() && !wrong && timers.empty() && ref.use_count() == 1;
+    InfoL << "TimingWheel " << delays.size() << "个定时器, 取消一半耗时:" << cancel_ms << "ms, 触发个数:" << fired
+          << ", 取消个数:" << cancelled << (ok ? ", 通过" : ", 失败");
+    return ok;
+}
+
+/**
+ * 对比时间轮与multimap的定时器插入与到期耗时
+ * 时间为模拟时间，每次推进1毫秒，与EventPoller的最小精度一致
+ * 用法: test_timingWheelBenchmark [最大延时毫秒数]
+ */
+int main(int argc, char *argv[]) {
+    signal(SIGINT, [](int) {
+        exit(0);
+    });
+    //初始化日志系统
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+
+    uint64_t max_delay = argc > 1 ? strtoull(argv[1], nullptr, 10) : 60 * 1000;
+    mt19937_64 engine(0);
+    uniform_int_distribution<uint64_t> distribution(1, max_delay);
+
+    for (size_t count : {10 * 1000, 100 * 1000, 1000 * 1000}) {
+        vector<uint64_t> delays(count);
+        for (auto &delay : delays) {
+            delay = distribution(engine);
+        }
+        benchMultimap(delays, max_delay);
+        if (!benchTimingWheel(delays, max_delay)) {
+            ErrorL << "TimingWheel存在漏触发或未准时触发的定时器";
+            return 1;
+        }
+        if (!benchCancel(delays, max_delay)) {
+            ErrorL << "TimingWheel取消定时器失败";
+            return 1;
+        }
+    }
+    return 0;
+}
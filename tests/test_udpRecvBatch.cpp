@@ -0,0 +1,136 @@
+﻿/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/xia-chu/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <signal.h>
+#include <atomic>
+#include <vector>
+#include <iostream>
+#include "Util/logger.h"
+#include "Network/Socket.h"
+
+using namespace std;
+using namespace toolkit;
+
+//每轮发送的数据包个数
+static constexpr int kPacketCount = 40;
+
+//第index个数据包的内容，长度各不相同
+static string makePacket(int index) {
+    return string(index * 37 + 1, 'a' + index % 26);
+}
+
+//向本地端口发送一轮数据包
+static void sendPackets(int fd, uint16_t port) {
+    struct sockaddr addr;
+    SockUtil::getDomainIP("127.0.0.1", port, addr);
+    for (int i = 0; i < kPacketCount; ++i) {
+        auto packet = makePacket(i);
+        ::sendto(fd, packet.data(), packet.size(), 0, &addr, sizeof(struct sockaddr_in));
+    }
+}
+
+/**
+ * 直接使用udp接收缓存读取，检查批量读取到的数据包个数、内容与来源地址
+ */
+static bool testRecvBuffer(bool use_pool) {
+    auto fd_recv = SockUtil::bindUdpSock(0, "127.0.0.1");
+    auto fd_send = SockUtil::bindUdpSock(0, "127.0.0.1");
+    SockUtil::setNoBlocked(fd_recv);
+    sendPackets(fd_send, SockUtil::get_local_port(fd_recv));
+
+    auto buffer = SocketRecvBuffer::create(true, use_pool);
+    vector<string> packets;
+    ssize_t max_count = 0;
+    bool addr_ok = true;
+    while (true) {
+        ssize_t count = 0;
+        auto nread = buffer->recvFromSocket(fd_recv, count);
+        if (nread <= 0) {
+            break;
+        }
+        max_count = max(max_count, count);
+        for (ssize_t i = 0; i < count; ++i) {
+            int addr_len;
+            auto addr = buffer->getAddress(i, addr_len);
+            addr_ok = addr_ok && ntohs(((struct sockaddr_in *) addr)->sin_port) == SockUtil::get_local_port(fd_send);
+            auto &buf = buffer->getBuffer(i);
+            packets.emplace_back(buf->data(), buf->size());
+        }
+    }
+    close(fd_recv);
+    close(fd_send);
+
+    bool ok = addr_ok && packets.size() == (size_t) kPacketCount;
+    for (size_t i = 0; ok && i < packets.size(); ++i) {
+        ok = packets[i] == makePacket((int) i);
+    }
+#if defined(__linux__) || defined(__linux)
+    //linux下使用recvmmsg，一次应该读取到多个数据包
+    ok = ok && max_count > 1;
+#endif
+    InfoL << (use_pool ? "独享" : "共享") << "接收缓存, 收到数据包:" << packets.size() << "/" << kPacketCount
+          << ", 单次最多读取:" << max_count << (ok ? ", 通过" : ", 失败");
+    return ok;
+}
+
+/**
+ * 通过Socket接收，poller忙碌时积压的数据包应全部按顺序回调，某个数据包的回调抛异常不影响同批次其他数据包
+ */
+static bool testSocket() {
+    auto poller = EventPollerPool::Instance().getPoller();
+    auto sock = Socket::createSocket(poller, false);
+    sock->bindUdpSock(0, "127.0.0.1");
+    vector<string> packets;
+    atomic<size_t> received(0);
+    sock->setOnRead([&](const Buffer::Ptr &buf, struct sockaddr *, int) {
+        packets.emplace_back(buf->data(), buf->size());
+        ++received;
+        if (packets.size() == 2) {
+            throw std::runtime_error("onRead异常测试");
+        }
+    });
+
+    auto fd_send = SockUtil::bindUdpSock(0, "127.0.0.1");
+    //阻塞poller线程，使数据包在socket中积压
+    poller->async([]() { usleep(100 * 1000); });
+    sendPackets(fd_send, sock->get_local_port());
+    close(fd_send);
+    for (int i = 0; i < 300 && received < (size_t) kPacketCount; ++i) {
+        usleep(10 * 1000);
+    }
+    bool ok = true;
+    //在poller线程中读取结果，防止与回调竞争
+    poller->sync([&]() {
+        ok = packets.size() == (size_t) kPacketCount;
+        for (size_t i = 0; ok && i < packets.size(); ++i) {
+            ok = packets[i] == makePacket((int) i);
+        }
+    });
+    InfoL << "Socket接收, 收到数据包:" << packets.size() << "/" << kPacketCount << (ok ? ", 通过" : ", 失败");
+    return ok;
+}
+
+/**
+ * udp批量接收(recvmmsg)功能测试
+ */
+int main() {
+    signal(SIGINT, [](int) { exit(0); });
+    //初始化日志系统
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+
+    bool ok = testRecvBuffer(false);
+    ok = testRecvBuffer(true) && ok;
+    ok = testSocket() && ok;
+    if (!ok) {
+        ErrorL << "udp批量接收测试失败";
+        return 1;
+    }
+    return 0;
+}
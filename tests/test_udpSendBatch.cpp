@@ -0,0 +1,129 @@
+﻿/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/xia-chu/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <signal.h>
+#include <vector>
+#include <iostream>
+#include "Util/logger.h"
+#include "Network/Socket.h"
+
+using namespace std;
+using namespace toolkit;
+
+//每轮发送的数据包个数
+static constexpr int kPacketCount = 100;
+//数据包大小，最后一个数据包更小
+static constexpr size_t kPacketSize = 1200;
+
+//第index个数据包的内容
+static string makePacket(int index) {
+    string ret(index + 1 == kPacketCount ? kPacketSize / 2 : kPacketSize, 'a' + index % 26);
+    memcpy(&ret[0], &index, sizeof(index));
+    return ret;
+}
+
+/**
+ * 在poller线程中先积压一批数据包再一次性刷新，检查接收端收到的数据包与发送的系统调用次数
+ * @param sock 发送socket
+ * @param syscalls 返回发送的系统调用次数
+ */
+static bool sendPackets(const Socket::Ptr &sock, uint64_t &syscalls) {
+    auto fd_recv = SockUtil::bindUdpSock(0, "127.0.0.1");
+    SockUtil::setRecvBuf(fd_recv, 4 * 1024 * 1024);
+    struct timeval tv = {1, 0};
+    setsockopt(fd_recv, SOL_SOCKET, SO_RCVTIMEO, (char *) &tv, sizeof(tv));
+    struct sockaddr addr;
+    SockUtil::getDomainIP("127.0.0.1", SockUtil::get_local_port(fd_recv), addr);
+
+    auto packets = BufferList::getUdpSendPackets();
+    syscalls = BufferList::getUdpSendSyscalls();
+    sock->getPoller()->sync([&]() {
+        for (int i = 0; i < kPacketCount; ++i) {
+            //只有最后一个数据包触发写socket
+            sock->send(makePacket(i), &addr, sizeof(struct sockaddr_in), i + 1 == kPacketCount);
+        }
+    });
+    packets = BufferList::getUdpSendPackets() - packets;
+    syscalls = BufferList::getUdpSendSyscalls() - syscalls;
+
+    int received = 0;
+    bool ok = true;
+    char buf[64 * 1024];
+    while (received < kPacketCount) {
+        auto n = recv(fd_recv, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            break;
+        }
+        ok = ok && string(buf, n) == makePacket(received);
+        ++received;
+    }
+    close(fd_recv);
+
+#if defined(__linux__) || defined(__linux)
+    //linux下使用sendmmsg，系统调用次数应该远少于数据包个数
+    ok = ok && syscalls && syscalls * 4 <= packets;
+#endif
+    ok = ok && received == kPacketCount;
+    InfoL << "收到数据包:" << received << "/" << kPacketCount << ", 发送数据包:" << packets << ", 系统调用次数:" << syscalls
+          << (ok ? ", 通过" : ", 失败");
+    return ok;
+}
+
+static Socket::Ptr createSocket(bool enable_gso) {
+    auto sock = Socket::createSocket(EventPollerPool::Instance().getPoller(), false);
+    sock->bindUdpSock(0, "127.0.0.1");
+    sock->enableUdpGso(enable_gso);
+    return sock;
+}
+
+/**
+ * 某个socket不支持UDP_SEGMENT时只关闭该socket的udp gso，不影响其他socket
+ */
+static bool testGsoFallback() {
+    uint64_t syscalls_gso, syscalls_plain, syscalls;
+    auto sock_gso = createSocket(true);
+    bool ok = sendPackets(sock_gso, syscalls_gso);
+    ok = sendPackets(createSocket(false), syscalls_plain) && ok;
+    if (syscalls_gso >= syscalls_plain) {
+        WarnL << "本机不支持UDP_SEGMENT，跳过udp gso回退测试";
+        return ok;
+    }
+#if defined(__linux__) || defined(__linux)
+    //关闭udp校验和后内核拒绝UDP_SEGMENT(EINVAL)，模拟路由或网卡不支持的socket
+    auto sock_bad = createSocket(true);
+    int on = 1;
+    setsockopt(sock_bad->rawFD(), SOL_SOCKET, SO_NO_CHECK, &on, sizeof(on));
+    ok = sendPackets(sock_bad, syscalls) && ok;
+    //回退后该socket不再尝试udp gso
+    ok = sendPackets(sock_bad, syscalls) && ok;
+    ok = ok && syscalls == syscalls_plain;
+    //其他socket仍然使用udp gso
+    ok = sendPackets(sock_gso, syscalls) && ok;
+    ok = ok && syscalls == syscalls_gso;
+#endif
+    InfoL << "udp gso回退测试" << (ok ? "通过" : "失败");
+    return ok;
+}
+
+/**
+ * udp批量发送(sendmmsg/UDP_SEGMENT)功能测试
+ */
+int main() {
+    signal(SIGINT, [](int) { exit(0); });
+    //初始化日志系统
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+
+    bool ok = testGsoFallback();
+    if (!ok) {
+        ErrorL << "udp批量发送测试失败";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,138 @@
+﻿/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/xia-chu/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <signal.h>
+#include <set>
+#include <mutex>
+#include <vector>
+#include <atomic>
+#include <iostream>
+#include "Util/logger.h"
+#include "Thread/WorkThreadPool.h"
+#include "Thread/WorkStealingThreadPool.h"
+
+using namespace std;
+using namespace toolkit;
+
+//线程个数与子任务个数
+static constexpr int kThreadCount = 4;
+static constexpr int kTaskCount = 64;
+
+/**
+ * 线程池内部线程投递的子任务压入本线程的列队，投递者一直忙碌直到子任务全部完成，
+ * 所以子任务只能被其他空闲线程窃取执行
+ */
+static bool testSteal() {
+    WorkStealingThreadPool pool(kThreadCount);
+    atomic<int> done(0);
+    atomic<bool> timeout(false);
+    mutex mtx;
+    set<thread::id> threads;
+    thread::id owner;
+    semaphore sem;
+    pool.async([&]() {
+        owner = this_thread::get_id();
+        for (int i = 0; i < kTaskCount; ++i) {
+            pool.async([&]() {
+                {
+                    lock_guard<mutex> lck(mtx);
+                    threads.emplace(this_thread::get_id());
+                }
+                usleep(1000);
+                ++done;
+            }, false);
+        }
+        //等待子任务完成，期间本线程不从自己的列队取任务
+        for (int i = 0; i < 3000 && done < kTaskCount; ++i) {
+            usleep(1000);
+        }
+        timeout = done < kTaskCount;
+        sem.post();
+    });
+    sem.wait();
+    bool ok = !timeout && !threads.count(owner) && threads.size() > 1;
+    InfoL << "工作窃取, 完成子任务:" << done << "/" << kTaskCount << ", 窃取线程数:" << threads.size() << (ok ? ", 通过" : ", 失败");
+    return ok;
+}
+
+/**
+ * 单线程时没有窃取，内部线程与外部线程投递的任务都按投递顺序执行，async与post混合投递亦然；
+ * async_first投递的任务优先执行，后投递的先执行
+ */
+static bool testOrder() {
+    WorkStealingThreadPool pool(1);
+    //只在线程池线程中访问
+    vector<int> inner, outer;
+    semaphore sem;
+    pool.async([&]() {
+        for (int i = 0; i < kTaskCount; ++i) {
+            if (i % 2) {
+                pool.post([&inner, i]() { inner.emplace_back(i); }, false);
+            } else {
+                pool.async([&inner, i]() { inner.emplace_back(i); }, false);
+            }
+        }
+        pool.async_first([&inner]() { inner.emplace_back(-1); }, false);
+        pool.async_first([&inner]() { inner.emplace_back(-2); }, false);
+        pool.async([&]() { sem.post(); }, false);
+    });
+    sem.wait();
+    for (int i = 0; i < kTaskCount; ++i) {
+        pool.post([&outer, i]() { outer.emplace_back(i); });
+    }
+    pool.async([&]() { sem.post(); });
+    sem.wait();
+
+    bool ok = inner.size() == kTaskCount + 2 && inner[0] == -2 && inner[1] == -1 && outer.size() == kTaskCount;
+    for (int i = 0; ok && i < kTaskCount; ++i) {
+        ok = inner[i + 2] == i && outer[i] == i;
+    }
+    InfoL << "任务执行顺序, 内部线程投递:" << inner.size() << ", 外部线程投递:" << outer.size() << (ok ? ", 通过" : ", 失败");
+    return ok;
+}
+
+/**
+ * WorkThreadPool开启工作窃取后，getExecutor返回工作窃取线程池，getPoller仍返回EventPoller
+ */
+static bool testWorkThreadPool() {
+    WorkThreadPool::setPoolSize(kThreadCount);
+    WorkThreadPool::enableWorkStealing(true);
+    auto executor = WorkThreadPool::Instance().getExecutor();
+    bool ok = dynamic_pointer_cast<WorkStealingThreadPool>(executor) != nullptr;
+    ok = ok && WorkThreadPool::Instance().getPoller() != nullptr;
+    atomic<int> done(0);
+    for (int i = 0; i < kTaskCount; ++i) {
+        executor->async([&]() { ++done; });
+    }
+    for (int i = 0; i < 300 && done < kTaskCount; ++i) {
+        usleep(10 * 1000);
+    }
+    ok = ok && done == kTaskCount;
+    InfoL << "WorkThreadPool工作窃取模式, 完成任务:" << done << "/" << kTaskCount << (ok ? ", 通过" : ", 失败");
+    return ok;
+}
+
+/**
+ * 工作窃取线程池功能测试
+ */
+int main() {
+    signal(SIGINT, [](int) { exit(0); });
+    //初始化日志系统
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+
+    bool ok = testSteal();
+    ok = testOrder() && ok;
+    ok = testWorkThreadPool() && ok;
+    if (!ok) {
+        ErrorL << "工作窃取线程池测试失败";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,297 @@
+﻿/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/xia-chu/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <signal.h>
+#include <atomic>
+#include <thread>
+#include <iostream>
+#if defined(__linux__) || defined(__linux)
+#include <dlfcn.h>
+#include <linux/errqueue.h>
+#endif
+#include "Util/logger.h"
+#include "Network/Socket.h"
+
+using namespace std;
+using namespace toolkit;
+
+//每轮发送的数据包个数与大小
+static constexpr int kPacketCount = 64;
+static constexpr size_t kPacketSize = 64 * 1024;
+
+//发送结果统计
+static atomic<int> s_success(0);
+static atomic<int> s_failed(0);
+
+#if defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+
+//被监视的tcp socket，其MSG_ZEROCOPY发送与完成通知均由本测试模拟
+static atomic<int> s_watch_fd(-1);
+//模拟成功的MSG_ZEROCOPY发送次数
+static atomic<int> s_zerocopy_sent(0);
+//已经通知完成的MSG_ZEROCOPY发送次数
+static atomic<int> s_zerocopy_done(0);
+//是否开始通知发送完成
+static atomic<bool> s_notify(false);
+//单次模拟的MSG_ZEROCOPY发送最多发出的字节数，使数据包只发出一部分
+static constexpr size_t kPartialSize = 64 * 1024;
+
+//拦截sendmsg：第一次MSG_ZEROCOPY发送只发出部分数据，之后的MSG_ZEROCOPY发送均返回ENOBUFS，迫使剩余数据以普通方式发送
+extern "C" ssize_t sendmsg(int fd, const struct msghdr *msg, int flags) {
+    using sendmsg_t = ssize_t (*)(int, const struct msghdr *, int);
+    static auto s_sendmsg = (sendmsg_t) dlsym(RTLD_NEXT, "sendmsg");
+    if (fd != s_watch_fd || !(flags & MSG_ZEROCOPY)) {
+        return s_sendmsg(fd, msg, flags);
+    }
+    if (s_zerocopy_sent) {
+        errno = ENOBUFS;
+        return -1;
+    }
+    //实际以拷贝方式发送，内核不会产生完成通知，由拦截的recvmsg模拟
+    struct iovec iov = msg->msg_iov[0];
+    iov.iov_len = std::min(iov.iov_len, kPartialSize);
+    struct msghdr partial = *msg;
+    partial.msg_iov = &iov;
+    partial.msg_iovlen = 1;
+    auto n = s_sendmsg(fd, &partial, flags & ~MSG_ZEROCOPY);
+    if (n > 0) {
+        ++s_zerocopy_sent;
+    }
+    return n;
+}
+
+//拦截读取错误列队的recvmsg：开始通知后，模拟内核一次通知所有MSG_ZEROCOPY发送完成
+extern "C" ssize_t recvmsg(int fd, struct msghdr *msg, int flags) {
+    using recvmsg_t = ssize_t (*)(int, struct msghdr *, int);
+    static auto s_recvmsg = (recvmsg_t) dlsym(RTLD_NEXT, "recvmsg");
+    if (fd != s_watch_fd || !(flags & MSG_ERRQUEUE)) {
+        return s_recvmsg(fd, msg, flags);
+    }
+    int sent = s_zerocopy_sent;
+    if (!s_notify || s_zerocopy_done == sent) {
+        errno = EAGAIN;
+        return -1;
+    }
+    auto cm = CMSG_FIRSTHDR(msg);
+    cm->cmsg_level = SOL_IP;
+    cm->cmsg_type = IP_RECVERR;
+    cm->cmsg_len = CMSG_LEN(sizeof(struct sock_extended_err));
+    auto serr = (struct sock_extended_err *) CMSG_DATA(cm);
+    memset(serr, 0, sizeof(*serr));
+    serr->ee_origin = SO_EE_ORIGIN_ZEROCOPY;
+    serr->ee_info = (uint32_t) s_zerocopy_done;
+    serr->ee_data = (uint32_t) sent - 1;
+    msg->msg_controllen = CMSG_SPACE(sizeof(struct sock_extended_err));
+    s_zerocopy_done = sent;
+    return 0;
+}
+
+//数据包内存回收时已经通知完成的MSG_ZEROCOPY发送次数，-1代表尚未回收
+static atomic<int> s_released_done(-1);
+
+class TrackedBuffer : public BufferString {
+public:
+    TrackedBuffer(string str) : BufferString(std::move(str)) {}
+    ~TrackedBuffer() override {
+        s_released_done = (int) s_zerocopy_done;
+    }
+};
+
+#endif
+
+/**
+ * 监听本地端口并在后台线程中读取所有数据直到对方断开
+ */
+class Receiver {
+public:
+    Receiver() {
+        _listen_fd = SockUtil::listen(0, "127.0.0.1");
+        SockUtil::setNoBlocked(_listen_fd, false);
+        _port = SockUtil::get_local_port(_listen_fd);
+        _thread = thread([this]() {
+            auto fd = (int) ::accept(_listen_fd, nullptr, nullptr);
+            SockUtil::setNoBlocked(fd, false);
+            char buf[64 * 1024];
+            while (true) {
+                auto n = ::recv(fd, buf, sizeof(buf), 0);
+                if (n <= 0) {
+                    break;
+                }
+                _bytes += n;
+            }
+            close(fd);
+        });
+    }
+
+    ~Receiver() {
+        wait();
+        close(_listen_fd);
+    }
+
+    uint16_t port() const {
+        return _port;
+    }
+
+    //等待对方断开，返回收到的字节数
+    size_t wait() {
+        if (_thread.joinable()) {
+            _thread.join();
+        }
+        return _bytes;
+    }
+
+private:
+    int _listen_fd;
+    uint16_t _port;
+    atomic<size_t> _bytes {0};
+    thread _thread;
+};
+
+//连接并等待连接结果
+static bool connectTo(const Socket::Ptr &sock, uint16_t port) {
+    atomic<int> result(-1);
+    sock->connect("127.0.0.1", port, [&](const SockException &ex) { result = ex ? 0 : 1; }, 3);
+    for (int i = 0; i < 300 && result == -1; ++i) {
+        usleep(10 * 1000);
+    }
+    return result == 1;
+}
+
+//在poller线程中发送一轮数据包，每个数据包都带发送结果回调
+static void sendPackets(const Socket::Ptr &sock) {
+    for (int i = 0; i < kPacketCount; ++i) {
+        auto buf = std::make_shared<BufferString>(string(kPacketSize, 'a' + i % 26));
+        sock->send(std::make_shared<BufferSock>(buf, nullptr, 0, [](size_t n) {
+            if (n) {
+                ++s_success;
+            } else {
+                ++s_failed;
+            }
+        }));
+    }
+}
+
+//等待所有发送结果回调
+static void waitResult(int expect) {
+    for (int i = 0; i < 500 && s_success + s_failed < expect; ++i) {
+        usleep(10 * 1000);
+    }
+}
+
+/**
+ * 零拷贝发送的数据包在内核通知发送完成后才回收，并触发发送成功回调
+ */
+static bool testComplete() {
+    s_success = s_failed = 0;
+    auto poller = EventPollerPool::Instance().getPoller();
+    bool ok;
+    {
+        Receiver receiver;
+        auto sock = Socket::createSocket(poller, false);
+        sock->enableZeroCopy(true, 1024);
+        ok = connectTo(sock, receiver.port());
+        poller->sync([&]() { sendPackets(sock); });
+        waitResult(kPacketCount);
+        ok = ok && s_success == kPacketCount && s_failed == 0;
+        poller->sync([&]() { sock->closeSock(); });
+        sock = nullptr;
+    }
+    InfoL << "零拷贝发送完成回调, 成功:" << s_success << ", 失败:" << s_failed << "/" << kPacketCount << (ok ? ", 通过" : ", 失败");
+    return ok;
+}
+
+/**
+ * 零拷贝发送后立即重新连接，原fd上尚未收到通知的数据包不能被丢弃，应继续等待原fd的完成通知
+ */
+static bool testReconnect() {
+    s_success = s_failed = 0;
+    auto poller = EventPollerPool::Instance().getPoller();
+    bool ok;
+    size_t bytes;
+    {
+        Receiver first, second;
+        auto sock = Socket::createSocket(poller, false);
+        sock->enableZeroCopy(true, 1024);
+        ok = connectTo(sock, first.port());
+        //在同一个poller任务中发送并重连，此时原fd上的完成通知均未被读取
+        poller->sync([&]() {
+            sendPackets(sock);
+            sock->connect("127.0.0.1", second.port(), [](const SockException &) {}, 3);
+        });
+        waitResult(kPacketCount);
+        ok = ok && s_success == kPacketCount && s_failed == 0;
+        poller->sync([&]() { sock->closeSock(); });
+        sock = nullptr;
+        //原连接在完成通知全部收到后才关闭；尚未写入原连接的数据在重连后发送至新连接
+        bytes = first.wait() + second.wait();
+    }
+    ok = ok && bytes == kPacketCount * kPacketSize;
+    InfoL << "零拷贝发送后重连, 成功:" << s_success << ", 失败:" << s_failed << "/" << kPacketCount << ", 收到字节数:" << bytes
+          << (ok ? ", 通过" : ", 失败");
+    return ok;
+}
+
+#if defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+/**
+ * 数据包部分数据以零拷贝方式发出后，剩余数据因ENOBUFS以普通方式发送完毕，
+ * 该数据包仍需等待内核通知之前的零拷贝发送完成后才能回收
+ */
+static bool testMixedSend() {
+    auto poller = EventPollerPool::Instance().getPoller();
+    bool ok, held;
+    size_t bytes;
+    {
+        Receiver receiver;
+        auto sock = Socket::createSocket(poller, false);
+        sock->enableZeroCopy(true, 1024);
+        ok = connectTo(sock, receiver.port());
+        s_watch_fd = sock->rawFD();
+        poller->sync([&]() { sock->send(Buffer::Ptr(std::make_shared<TrackedBuffer>(string(kPacketSize * 16, 'a')))); });
+        //等待全部数据写入socket
+        for (int i = 0; i < 300 && sock->getSendBufferBytes(); ++i) {
+            usleep(10 * 1000);
+        }
+        usleep(100 * 1000);
+        held = s_released_done == -1;
+        //开始通知完成，销毁socket后继续读取原fd的错误列队
+        s_notify = true;
+        sock = nullptr;
+        for (int i = 0; i < 300 && s_released_done == -1; ++i) {
+            usleep(10 * 1000);
+        }
+        bytes = receiver.wait();
+        s_watch_fd = -1;
+    }
+    ok = ok && s_zerocopy_sent == 1 && held && s_released_done == 1 && bytes == kPacketSize * 16;
+    InfoL << "零拷贝与普通方式混合发送, 完成通知前是否保留数据包:" << held << ", 回收时已完成的零拷贝发送次数:" << s_released_done
+          << "/" << s_zerocopy_sent << ", 收到字节数:" << bytes << (ok ? ", 通过" : ", 失败");
+    return ok;
+}
+#endif
+
+/**
+ * tcp零拷贝发送(MSG_ZEROCOPY)功能测试
+ */
+int main() {
+    signal(SIGINT, [](int) { exit(0); });
+    //初始化日志系统
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+
+    bool ok = testComplete();
+    ok = testReconnect() && ok;
+#if defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+    ok = testMixedSend() && ok;
+#endif
+    if (!ok) {
+        ErrorL << "tcp零拷贝发送测试失败";
+        return 1;
+    }
+    return 0;
+}